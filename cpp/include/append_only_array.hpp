@@ -0,0 +1,45 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <utility>
+
+namespace trading {
+
+// Fixed-capacity array that only grows. Elements never move, so other
+// threads may index any slot below size() while a single writer appends.
+template <typename T>
+class AppendOnlyArray {
+public:
+    explicit AppendOnlyArray(std::size_t capacity)
+        : slots_(std::make_unique<std::unique_ptr<T>[]>(capacity)), capacity_(capacity) {}
+
+    AppendOnlyArray(const AppendOnlyArray&) = delete;
+    AppendOnlyArray& operator=(const AppendOnlyArray&) = delete;
+
+    // Appends must be serialized by the caller. Returns nullptr when full.
+    template <typename... Args>
+    T* emplace_back(Args&&... args) {
+        std::size_t index = size_.load(std::memory_order_relaxed);
+        if (index >= capacity_) {
+            return nullptr;
+        }
+        slots_[index] = std::make_unique<T>(std::forward<Args>(args)...);
+        size_.store(index + 1, std::memory_order_release);
+        return slots_[index].get();
+    }
+
+    T& operator[](std::size_t index) { return *slots_[index]; }
+    const T& operator[](std::size_t index) const { return *slots_[index]; }
+
+    std::size_t size() const { return size_.load(std::memory_order_acquire); }
+    std::size_t capacity() const { return capacity_; }
+
+private:
+    std::unique_ptr<std::unique_ptr<T>[]> slots_;
+    std::size_t capacity_;
+    std::atomic<std::size_t> size_{0};
+};
+
+} // namespace trading
@@ -10,6 +10,12 @@ extern "C" {
     void start_engine(trading::ExecutionEngine* engine);
     void stop_engine(trading::ExecutionEngine* engine);
 
+    // Symbol registration; returns a dense id usable with the *_by_id calls
+    int register_symbol(
+        trading::ExecutionEngine* engine,
+        const char* symbol
+    );
+
     // Order management
     const char* submit_order(
         trading::ExecutionEngine* engine,
@@ -19,11 +25,70 @@ extern "C" {
         int side  // 0 for Buy, 1 for Sell
     );
 
+    // order_type: 0 Limit, 1 Market, 2 IOC, 3 FOK, 4 Post-only,
+    // 5 Stop, 6 Stop-limit (price is both trigger and limit)
+    const char* submit_order_by_id(
+        trading::ExecutionEngine* engine,
+        int symbol_id,
+        double price,
+        int quantity,
+        int side,  // 0 for Buy, 1 for Sell
+        int order_type
+    );
+
+    // Limit order showing at most display_quantity at a time
+    const char* submit_iceberg_order(
+        trading::ExecutionEngine* engine,
+        int symbol_id,
+        double price,
+        int quantity,
+        int side,  // 0 for Buy, 1 for Sell
+        int display_quantity
+    );
+
+    // order_type: 5 Stop (limit_price unused) or 6 Stop-limit
+    const char* submit_stop_order(
+        trading::ExecutionEngine* engine,
+        int symbol_id,
+        double stop_price,
+        double limit_price,
+        int quantity,
+        int side,  // 0 for Buy, 1 for Sell
+        int order_type
+    );
+
+    // submit_order_by_id on behalf of an account; the others trade for
+    // account 0
+    const char* submit_account_order(
+        trading::ExecutionEngine* engine,
+        unsigned int account,
+        int symbol_id,
+        double price,
+        int quantity,
+        int side,  // 0 for Buy, 1 for Sell
+        int order_type
+    );
+
     bool cancel_order(
         trading::ExecutionEngine* engine,
         const char* order_id
     );
 
+    // Amends price and/or quantity; shrinking at the same price keeps
+    // queue priority
+    bool modify_order(
+        trading::ExecutionEngine* engine,
+        const char* order_id,
+        double price,
+        int quantity
+    );
+
+    // Returns the number of resting orders cancelled
+    int cancel_all_orders(
+        trading::ExecutionEngine* engine,
+        const char* symbol
+    );
+
     // Position information
     int get_position(
         trading::ExecutionEngine* engine,
@@ -45,6 +110,98 @@ extern "C" {
         const char* symbol
     );
 
+    // Top of book; 0 for an empty side or an unknown symbol
+    double get_best_bid(
+        trading::ExecutionEngine* engine,
+        const char* symbol
+    );
+
+    double get_best_ask(
+        trading::ExecutionEngine* engine,
+        const char* symbol
+    );
+
+    // Per-account versions of the above; the plain ones report account 0
+    int get_account_position(
+        trading::ExecutionEngine* engine,
+        unsigned int account,
+        const char* symbol
+    );
+
+    double get_account_average_price(
+        trading::ExecutionEngine* engine,
+        unsigned int account,
+        const char* symbol
+    );
+
+    double get_account_unrealized_pnl(
+        trading::ExecutionEngine* engine,
+        unsigned int account,
+        const char* symbol
+    );
+
+    double get_account_realized_pnl(
+        trading::ExecutionEngine* engine,
+        unsigned int account,
+        const char* symbol
+    );
+
+    // Batch getters fill caller-owned arrays, one entry per symbol, so a
+    // portfolio is read in one call. Any output array may be null to skip
+    // that column. Each entry is a consistent snapshot of its symbol;
+    // unknown ids read as flat and empty. Return the entries written.
+    int get_symbol_count(trading::ExecutionEngine* engine);
+
+    int get_positions_batch(
+        trading::ExecutionEngine* engine,
+        unsigned int account,
+        const int* symbol_ids,
+        int count,
+        int* positions,
+        double* average_prices,
+        double* realized_pnls,
+        double* unrealized_pnls
+    );
+
+    // Every registered symbol, in id order, up to capacity entries.
+    // symbol_ids receives the id of each row.
+    int get_all_positions(
+        trading::ExecutionEngine* engine,
+        unsigned int account,
+        int capacity,
+        int* symbol_ids,
+        int* positions,
+        double* average_prices,
+        double* realized_pnls,
+        double* unrealized_pnls
+    );
+
+    int get_top_of_book_batch(
+        trading::ExecutionEngine* engine,
+        const int* symbol_ids,
+        int count,
+        double* best_bids,
+        double* best_asks,
+        int* bid_quantities,
+        int* ask_quantities,
+        double* last_prices
+    );
+
+    // Depth snapshot, best first, at most levels per side, into the
+    // caller's arrays. bid_count and ask_count receive the levels written.
+    // Returns the sequence of the last depth update the snapshot includes.
+    unsigned long long get_depth(
+        trading::ExecutionEngine* engine,
+        int symbol_id,
+        int levels,
+        double* bid_prices,
+        int* bid_quantities,
+        int* bid_count,
+        double* ask_prices,
+        int* ask_quantities,
+        int* ask_count
+    );
+
     // Market data subscription
     void subscribe_market_data(
         trading::ExecutionEngine* engine,
@@ -68,4 +225,36 @@ extern "C" {
         trading::ExecutionEngine* engine,
         const char* symbol
     );
+
+    // Depth updates; action 0 Add, 1 Change, 2 Delete; side 0 Buy, 1 Sell
+    void subscribe_depth(
+        trading::ExecutionEngine* engine,
+        const char* symbol,
+        void (*callback)(int action, int side, double price, int quantity, unsigned long long sequence)
+    );
+
+    void unsubscribe_depth(
+        trading::ExecutionEngine* engine,
+        const char* symbol
+    );
+
+    // Order-by-order feed. The reader starts at the symbol's next event and
+    // must be closed; unknown ids give a reader that never has events.
+    trading::L3Reader* open_l3_feed(
+        trading::ExecutionEngine* engine,
+        int symbol_id
+    );
+
+    // Copies up to capacity events, oldest first, and returns how many.
+    // If the reader was overrun it skips ahead; the sequence numbers show
+    // where, and get_l3_missed counts the lost events.
+    int poll_l3_events(
+        trading::L3Reader* reader,
+        trading::L3Event* events,
+        int capacity
+    );
+
+    unsigned long long get_l3_missed(trading::L3Reader* reader);
+
+    void close_l3_feed(trading::L3Reader* reader);
 }
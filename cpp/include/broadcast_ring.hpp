@@ -0,0 +1,108 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <type_traits>
+
+namespace trading {
+
+// Bounded single-writer ring that any number of readers follow at their
+// own pace, each with its own position. The writer never waits: a reader
+// that falls a whole ring behind is overrun rather than blocking it. Each
+// slot carries a version stamp, so a read that races an overwrite is
+// reported as an overrun instead of returning a torn value.
+template <typename T>
+class BroadcastRing {
+    static_assert(std::is_trivially_copyable_v<T>, "BroadcastRing requires trivially copyable types");
+
+public:
+    enum class ReadStatus { Ok, Empty, Overrun };
+
+    // Capacity is rounded up to a power of two
+    explicit BroadcastRing(std::size_t capacity)
+        : capacity_(round_up_pow2(capacity)),
+          mask_(capacity_ - 1),
+          slots_(std::make_unique<Slot[]>(capacity_)) {}
+
+    BroadcastRing(const BroadcastRing&) = delete;
+    BroadcastRing& operator=(const BroadcastRing&) = delete;
+
+    // Pushes must be serialized by the caller
+    void push(const T& value) {
+        std::uint64_t words[kWords] = {};
+        std::memcpy(words, &value, sizeof(T));
+
+        std::uint64_t position = head_.load(std::memory_order_relaxed);
+        Slot& slot = slots_[position & mask_];
+        slot.version.store(2 * position + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        for (std::size_t i = 0; i < kWords; ++i) {
+            slot.words[i].store(words[i], std::memory_order_relaxed);
+        }
+        slot.version.store(2 * position + 2, std::memory_order_release);
+        head_.store(position + 1, std::memory_order_release);
+    }
+
+    // Position the next push will fill; new readers start here
+    std::uint64_t head() const { return head_.load(std::memory_order_acquire); }
+
+    // Oldest position that may still be read
+    std::uint64_t oldest() const {
+        std::uint64_t current = head();
+        return current > capacity_ ? current - capacity_ : 0;
+    }
+
+    // Empty if position has not been written yet; Overrun if it has
+    // already been overwritten, in which case resume from oldest()
+    ReadStatus read(std::uint64_t position, T& value) const {
+        const Slot& slot = slots_[position & mask_];
+        std::uint64_t expected = 2 * position + 2;
+        std::uint64_t before = slot.version.load(std::memory_order_acquire);
+        if (before < expected) {
+            return ReadStatus::Empty;
+        }
+        if (before > expected) {
+            return ReadStatus::Overrun;
+        }
+
+        std::uint64_t words[kWords];
+        for (std::size_t i = 0; i < kWords; ++i) {
+            words[i] = slot.words[i].load(std::memory_order_relaxed);
+        }
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (slot.version.load(std::memory_order_relaxed) != before) {
+            return ReadStatus::Overrun;
+        }
+        std::memcpy(&value, words, sizeof(T));
+        return ReadStatus::Ok;
+    }
+
+    std::size_t capacity() const { return capacity_; }
+
+private:
+    static constexpr std::size_t kWords = (sizeof(T) + sizeof(std::uint64_t) - 1) / sizeof(std::uint64_t);
+
+    struct Slot {
+        // 2 * position + 1 while being written, 2 * position + 2 once done
+        std::atomic<std::uint64_t> version{0};
+        std::atomic<std::uint64_t> words[kWords] = {};
+    };
+
+    static std::size_t round_up_pow2(std::size_t value) {
+        std::size_t result = 1;
+        while (result < value) {
+            result <<= 1;
+        }
+        return result;
+    }
+
+    std::size_t capacity_;
+    std::size_t mask_;
+    std::unique_ptr<Slot[]> slots_;
+    alignas(64) std::atomic<std::uint64_t> head_{0};
+};
+
+} // namespace trading
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+namespace trading {
+
+// Nanoseconds. Wall clock values count from the Unix epoch; monotonic
+// values only make sense relative to each other.
+using Timestamp = std::int64_t;
+
+inline Timestamp wall_clock_ns() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+inline Timestamp steady_clock_ns() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// Monotonic nanoseconds from the CPU timestamp counter, calibrated against
+// steady_clock on first use. Assumes an invariant TSC that is synchronized
+// across cores; without that, readings from different cores may not line
+// up. Falls back to steady_clock where there is no usable TSC.
+Timestamp tsc_clock_ns();
+
+// "YYYY-MM-DD HH:MM:SS.nnnnnnnnn" in local time. Only call this when text
+// is actually needed; hot paths carry the integer.
+std::string format_timestamp(Timestamp wall_ns);
+
+} // namespace trading
@@ -1,102 +1,642 @@
 #pragma once
 
+#include <cmath>
+#include <cstdint>
+#include <deque>
+#include <limits>
+#include <memory>
 #include <string>
-#include <queue>
+#include <string_view>
+#include <map>
+#include <memory_resource>
 #include <mutex>
+#include <span>
 #include <thread>
 #include <atomic>
 #include <functional>
 #include <unordered_map>
 #include <vector>
 
+#include "append_only_array.hpp"
+#include "broadcast_ring.hpp"
+#include "clock.hpp"
+#include "object_pool.hpp"
+#include "published_index.hpp"
+#include "seqlock.hpp"
+#include "subscriber_list.hpp"
+
 namespace trading {
 
+using OrderId = std::uint64_t;
+using SymbolId = std::uint32_t;
+using AccountId = std::uint32_t;
+// Prices inside the engine are integer ticks; doubles only exist at the API edge
+using Price = std::int64_t;
+
+constexpr std::int64_t kTicksPerUnit = 10000;
+
+inline Price to_ticks(double price) {
+    return static_cast<Price>(std::llround(price * kTicksPerUnit));
+}
+
+inline double from_ticks(Price ticks) {
+    return static_cast<double>(ticks) / kTicksPerUnit;
+}
+
+constexpr SymbolId kInvalidSymbol = std::numeric_limits<SymbolId>::max();
+// Orders that do not name an account trade for this one
+constexpr AccountId kDefaultAccount = 0;
+
+// Order ids carry their symbol in the low bits so cancels can be routed to
+// the owning book without a shared lookup table. Ids still increase with
+// submission order because the sequence occupies the high bits.
+constexpr int kOrderIdSymbolBits = 20;
+constexpr std::size_t kMaxSymbols = std::size_t{1} << kOrderIdSymbolBits;
+
+inline OrderId make_order_id(std::uint64_t sequence, SymbolId symbol) {
+    return (sequence << kOrderIdSymbolBits) | symbol;
+}
+
+inline SymbolId order_id_symbol(OrderId order_id) {
+    return static_cast<SymbolId>(order_id & (kMaxSymbols - 1));
+}
+
+std::string order_id_to_string(OrderId order_id);
+// Returns 0 (never a valid id) if the text is not an order id
+OrderId parse_order_id(const std::string& text);
+
+enum class OrderType : std::uint8_t {
+    Limit,              // Rests whatever does not fill immediately
+    Market,             // Takes any price; the unfilled remainder is dropped
+    ImmediateOrCancel,  // Limit price; the unfilled remainder is dropped
+    FillOrKill,         // Limit price; fills completely or not at all
+    PostOnly,           // Rests only; dropped if it would take liquidity
+    Stop,               // Held until a trade prints at or through stop_price, then Market
+    StopLimit,          // Held like Stop, then entered as Limit at price
+};
+
+inline bool is_stop_order(OrderType type) {
+    return type == OrderType::Stop || type == OrderType::StopLimit;
+}
+
 struct Order {
     std::string order_id;
     std::string symbol;
     double price;
     int quantity;
     bool is_buy;
+    OrderType type = OrderType::Limit;
+    // Iceberg peak: only this much is shown at a time. 0 shows everything.
+    // Only Limit orders may set it; any other type is rejected.
+    int display_quantity = 0;
+    // Trigger for Stop and StopLimit orders
+    double stop_price = 0.0;
+    AccountId account = kDefaultAccount;
 };
 
+// Timestamps are integer nanoseconds; use format_timestamp for text
 struct MarketData {
     std::string symbol;
     double price;
     double volume;
-    std::string timestamp;
+    Timestamp timestamp;            // Wall clock
+    Timestamp monotonic_timestamp;  // Steady or TSC clock, for latency math
 };
 
 struct Trade {
-    std::string order_id;
+    std::string order_id;           // Aggressor (incoming) order
     std::string symbol;
     double price;
     int quantity;
-    std::string timestamp;
+    Timestamp timestamp;            // Wall clock at match time
+    std::string passive_order_id;   // Resting order that was hit
+    bool aggressor_is_buy;
+    std::uint64_t sequence;         // Per-symbol fill sequence, starting at 1
+};
+
+// Compact form of an order as it rests in a book; the book knows its symbol
+struct BookOrder {
+    OrderId order_id;
+    Price price;
+    int quantity;
+    bool is_buy;
+    OrderType type = OrderType::Limit;
+    int display_quantity = 0;
+    Price stop_price = 0;
+    AccountId account = kDefaultAccount;
+};
+
+// One execution between an incoming order and a resting order, at the
+// resting order's price
+struct Fill {
+    OrderId aggressor_order_id;
+    OrderId passive_order_id;
+    Price price;
+    int quantity;
+    bool aggressor_is_buy;
+    std::uint64_t sequence;
+    Timestamp timestamp;
+    AccountId aggressor_account;
+    AccountId passive_account;
+};
+
+// Best prices and displayed sizes as last published by a book. Prices are
+// 0 for an empty side, and last_trade_price is 0 before the first fill.
+struct TopOfBook {
+    Price best_bid = 0;
+    Price best_ask = 0;
+    int bid_quantity = 0;
+    int ask_quantity = 0;
+    Price last_trade_price = 0;
+
+    // Mid when both sides are quoted, else the last trade
+    double mark_price() const {
+        return best_bid != 0 && best_ask != 0 ? from_ticks(best_bid + best_ask) / 2.0
+                                              : from_ticks(last_trade_price);
+    }
+
+    bool operator==(const TopOfBook&) const = default;
+};
+
+// Aggregated displayed size at one price
+struct DepthLevel {
+    Price price;
+    int quantity;
+};
+
+// Best-first levels of each side as of sequence, the last DepthUpdate
+// already reflected in it
+struct DepthSnapshot {
+    std::vector<DepthLevel> bids;
+    std::vector<DepthLevel> asks;
+    std::uint64_t sequence = 0;
+};
+
+// New displayed size of one price level. Sequence numbers are per book,
+// start at 1 and have no gaps, so applying every update after a
+// snapshot's sequence to that snapshot reproduces the book.
+struct DepthUpdate {
+    enum class Action : std::uint8_t { Add, Change, Delete };
+
+    Action action;
+    bool is_buy;
+    Price price;
+    int quantity;  // 0 for Delete
+    std::uint64_t sequence;
+};
+
+// One order-level book event. Fixed size with no owning fields, so it can
+// be copied through rings and files as raw bytes.
+struct L3Event {
+    enum class Type : std::uint8_t {
+        Add,      // Order joined the back of its level with quantity shown
+        Execute,  // Resting order traded quantity against other_order_id
+        Cancel,   // Quantity left the book; remaining is what still rests
+        Replace,  // Order left its place to be re-entered at price and
+                  // quantity (its full new size); an Add follows if it rests
+    };
+
+    std::uint64_t sequence;      // Per symbol, starting at 1, no gaps
+    Timestamp timestamp;         // Wall clock, one per book command
+    OrderId order_id;
+    OrderId other_order_id;      // Execute: the aggressor; otherwise 0
+    Price price;
+    std::int32_t quantity;
+    std::int32_t remaining_quantity;  // Displayed size still resting
+    SymbolId symbol;
+    Type type;
+    bool is_buy;
+};
+
+// Follows one symbol's L3 ring. Each reader keeps its own position, so any
+// number of consumers can follow a feed without slowing the matching
+// thread or each other. Not thread safe; use one reader per thread.
+class L3Reader {
+public:
+    enum class Status {
+        Ok,     // event is the next one in sequence
+        Empty,  // Caught up with the book
+        Gap,    // Lapped by the writer; events were skipped (see missed())
+                // and the next poll resumes at the oldest one still held
+    };
+
+    L3Reader() = default;
+    explicit L3Reader(std::shared_ptr<const BroadcastRing<L3Event>> ring)
+        : ring_(std::move(ring)), next_(ring_ ? ring_->head() : 0) {}
+
+    Status poll(L3Event& event) {
+        if (!ring_) {
+            return Status::Empty;
+        }
+        for (;;) {
+            switch (ring_->read(next_, event)) {
+                case BroadcastRing<L3Event>::ReadStatus::Ok:
+                    ++next_;
+                    return Status::Ok;
+                case BroadcastRing<L3Event>::ReadStatus::Empty:
+                    return Status::Empty;
+                case BroadcastRing<L3Event>::ReadStatus::Overrun:
+                    break;
+            }
+            std::uint64_t oldest = ring_->oldest();
+            if (oldest > next_) {
+                missed_ += oldest - next_;
+                next_ = oldest;
+                return Status::Gap;
+            }
+            // The read raced the push overwriting this slot, and head has
+            // not moved past it yet; retry until it has, so a gap always
+            // skips something
+            std::this_thread::yield();
+        }
+    }
+
+    // False for a reader of an unknown symbol, which never has events
+    bool attached() const { return ring_ != nullptr; }
+    // Events lost to overruns so far
+    std::uint64_t missed() const { return missed_; }
+
+private:
+    std::shared_ptr<const BroadcastRing<L3Event>> ring_;
+    std::uint64_t next_ = 0;
+    std::uint64_t missed_ = 0;
+};
+
+// Checks a stream of per-symbol sequence numbers, such as L3 events read
+// back from a file, for holes
+class SequenceGapDetector {
+public:
+    // Returns how many sequence numbers were skipped just before this one.
+    // Duplicates and replays of older numbers count as no gap.
+    std::uint64_t observe(std::uint64_t sequence) {
+        std::uint64_t gap = sequence > expected_ ? sequence - expected_ : 0;
+        missed_ += gap;
+        if (sequence >= expected_) {
+            expected_ = sequence + 1;
+        }
+        return gap;
+    }
+
+    std::uint64_t expected() const { return expected_; }
+    std::uint64_t missed() const { return missed_; }
+
+private:
+    std::uint64_t expected_ = 1;
+    std::uint64_t missed_ = 0;
+};
+
+// A book's full contents, as snapshots save and restore them
+struct BookState {
+    struct Resting {
+        BookOrder order;      // quantity is the displayed size
+        int hidden_quantity;  // Iceberg reserve
+    };
+
+    // Bids then asks, each best price first and in queue order within a
+    // level, so restoring them in order rebuilds time priority
+    std::vector<Resting> orders;
+    // Buy stops then sell stops, each in the order they would fire
+    std::vector<BookOrder> stops;
+    Price last_trade_price = 0;
+    std::uint64_t fill_sequence = 0;
+    std::uint64_t depth_sequence = 0;
+    std::uint64_t l3_sequence = 0;
 };
 
 using MarketDataCallback = std::function<void(const MarketData&)>;
 using TradeCallback = std::function<void(const Trade&)>;
+using DepthCallback = std::function<void(const DepthUpdate&)>;
 
 class OrderBook {
 public:
-    OrderBook() : position_(0), average_price_(0.0), realized_pnl_(0.0) {}
-    explicit OrderBook(const std::string& symbol) 
-        : symbol_(symbol), position_(0), average_price_(0.0), realized_pnl_(0.0) {}
+    OrderBook() : OrderBook(std::string()) {}
+    // symbol_id only stamps L3 events
+    explicit OrderBook(const std::string& symbol, SymbolId symbol_id = kInvalidSymbol);
     
-    // Delete copy operations
+    // Books own pooled nodes that point into their own ladders, and live in
+    // place in the engine's symbol array, so they are neither copied nor moved
     OrderBook(const OrderBook&) = delete;
     OrderBook& operator=(const OrderBook&) = delete;
-    
-    // Allow move operations
-    OrderBook(OrderBook&& other) noexcept
-        : symbol_(std::move(other.symbol_)),
-          buy_orders(std::move(other.buy_orders)),
-          sell_orders(std::move(other.sell_orders)),
-          position_(other.position_),
-          average_price_(other.average_price_),
-          realized_pnl_(other.realized_pnl_) {}
-    
-    OrderBook& operator=(OrderBook&& other) noexcept {
-        if (this != &other) {
-            symbol_ = std::move(other.symbol_);
-            buy_orders = std::move(other.buy_orders);
-            sell_orders = std::move(other.sell_orders);
-            position_ = other.position_;
-            average_price_ = other.average_price_;
-            realized_pnl_ = other.realized_pnl_;
-        }
-        return *this;
-    }
+    OrderBook(OrderBook&&) = delete;
+    OrderBook& operator=(OrderBook&&) = delete;
 
-    void add_order(const Order& order);
+    // Returns true if part of the order is left resting in the book; a
+    // stop waiting for its trigger counts as resting. Executions, including
+    // those of stops the order's trades set off, are appended to fills in
+    // the order they happened. Every mutating call appends one DepthUpdate
+    // per price level whose displayed size it changed, and stamps its fills
+    // and L3 events with time, or with the wall clock when time is 0.
+    bool add_order(const BookOrder& order, std::vector<Fill>* fills = nullptr,
+                   std::vector<DepthUpdate>* depth = nullptr, Timestamp time = 0);
+    bool cancel(OrderId order_id, std::vector<DepthUpdate>* depth = nullptr, Timestamp time = 0);
+    // Amends a resting order. A smaller quantity at the same price keeps
+    // its place in the queue; a new price or a larger quantity re-queues it
+    // at the back (and it may trade if the new price crosses). A quantity
+    // of zero cancels. Returns false if the order is not resting; stops
+    // still waiting for their trigger can only be cancelled.
+    bool modify(OrderId order_id, Price new_price, int new_quantity, std::vector<Fill>* fills = nullptr,
+                std::vector<DepthUpdate>* depth = nullptr, Timestamp time = 0);
+    std::size_t cancel_all(std::vector<DepthUpdate>* depth = nullptr, Timestamp time = 0);
+    const std::string& symbol() const { return symbol_; }
+    // These read the snapshot published after each command and never take
+    // book_mutex, so polling them does not contend with matching
+    TopOfBook get_top_of_book() const { return top_of_book_.load(); }
     double get_best_bid() const;
     double get_best_ask() const;
-    int get_position() const;
-    double get_average_price() const;
-    double get_unrealized_pnl() const;
-    double get_realized_pnl() const;
+    // 0 until the book has traded
+    double get_last_trade_price() const;
+    // At most levels per side; pass a large count to rebuild the whole book
+    void get_depth(std::size_t levels, DepthSnapshot& out) const;
+    // The book's L3 ring, allocated with capacity on first use. Events are
+    // only stored once the feed has been opened, but their sequence counts
+    // every event since the book was created.
+    std::shared_ptr<const BroadcastRing<L3Event>> open_l3_feed(std::size_t capacity);
+    // Copies out the whole book, reusing out's storage
+    void save(BookState& out) const;
+    // Replaces the book's contents. Feed sequences carry on from the saved
+    // ones, but no depth or L3 events are emitted for the restore itself.
+    void restore(const BookState& state);
 
 private:
-    void match_orders();
+    struct PriceLevel;
 
-    struct OrderCompare {
-        bool operator()(const Order& a, const Order& b) const {
-            return a.is_buy ? (a.price < b.price) : (a.price > b.price);
-        }
+    // A resting order, linked into its level's FIFO. order.quantity is the
+    // displayed size; an iceberg keeps the rest in hidden_quantity.
+    struct OrderNode {
+        BookOrder order;
+        OrderNode* prev;
+        OrderNode* next;
+        PriceLevel* level;
+        int hidden_quantity;
     };
 
+    // All resting orders at one price, oldest first (time priority)
+    struct PriceLevel {
+        Price price = 0;
+        int total_quantity = 0;   // Displayed size only
+        int hidden_quantity = 0;  // Iceberg reserve behind the displayed size
+        OrderNode* head = nullptr;
+        OrderNode* tail = nullptr;
+        std::uint64_t depth_epoch = 0;  // Command that last recorded a DepthTouch
+
+        bool empty() const { return head == nullptr; }
+        void push_back(OrderNode* node);
+        void unlink(OrderNode* node);
+    };
+
+    // Levels sorted best-first: highest bid, lowest ask. Ladder and index
+    // nodes come from the book's pool resource and are recycled, so the
+    // steady-state match path does not touch the global heap.
+    using BidLadder = std::pmr::map<Price, PriceLevel, std::greater<Price>>;
+    using AskLadder = std::pmr::map<Price, PriceLevel, std::less<Price>>;
+    // Pending stops keyed so the next to fire is always first: the stop
+    // price for buys, its negation for sells. Equal keys keep arrival order.
+    using StopQueue = std::pmr::multimap<Price, BookOrder>;
+
+    // A level changed by the current command and its displayed size
+    // before the command, diffed against the ladder once it finishes
+    struct DepthTouch {
+        bool is_buy;
+        Price price;
+        bool existed;
+        int quantity;
+    };
+
+    bool match_and_rest(BookOrder& incoming, std::vector<Fill>* fills);
+    static bool crosses(const BookOrder& incoming, Price level_price);
+    // Quantity the order could take right now, summed from level
+    // aggregates and stopping once the order's own size is covered
+    template <typename Ladder>
+    int available_quantity(const BookOrder& incoming, const Ladder& opposite) const;
+    void match_orders(BookOrder& incoming, std::vector<Fill>* fills);
+    template <typename Ladder>
+    void match_against(BookOrder& incoming, Ladder& opposite, std::vector<Fill>* fills);
+    template <typename Ladder>
+    void rest_order(const BookOrder& order, Ladder& ladder);
+    void remove_order(OrderNode* node);
+    void replenish(OrderNode* node);
+    // Queues a stop, or fires it at once if the last trade already crossed it
+    bool hold_stop(BookOrder& order, std::vector<Fill>* fills);
+    bool stop_triggered(const BookOrder& order) const;
+    bool fire_stop(BookOrder& order, std::vector<Fill>* fills);
+    // Fires stops crossed by the last trade, including any set off by the
+    // fires themselves. Costs O(log n) per stop fired, never a full scan.
+    void trigger_stops(std::vector<Fill>* fills);
+    // Records a level's state before its first change in this command
+    void touch_level(PriceLevel& level, bool is_buy);
+    void touch_new_level(PriceLevel& level, bool is_buy);
+    // Turns the command's touched levels into updates and starts a new epoch
+    void emit_depth(std::vector<DepthUpdate>* depth);
+    void emit_l3(L3Event::Type type, const BookOrder& order, Price price, int quantity,
+                 int remaining_quantity, OrderId other_order_id = 0);
+    // Called with book_mutex held at the end of every mutating call
+    void publish_top_of_book();
+    // Emits depth and publishes the top of book
+    void finish_command(std::vector<DepthUpdate>* depth);
+    // The current command's time, reading the wall clock at most once
+    Timestamp command_time();
+
     std::string symbol_;
-    std::priority_queue<Order, std::vector<Order>, OrderCompare> buy_orders;
-    std::priority_queue<Order, std::vector<Order>, OrderCompare> sell_orders;
-    int position_;
-    double average_price_;
-    double realized_pnl_;
+    SymbolId symbol_id_;
+    std::pmr::unsynchronized_pool_resource memory_;
+    ObjectPool<OrderNode> order_pool_;
+    BidLadder bids_;
+    AskLadder asks_;
+    // Resting order id -> node, so cancels never search the ladder
+    std::pmr::unordered_map<OrderId, OrderNode*> order_index_;
+    StopQueue buy_stops_;
+    StopQueue sell_stops_;
+    std::pmr::unordered_map<OrderId, StopQueue::iterator> stop_index_;
+    Price last_trade_price_ = 0;  // 0 until the first fill
+    std::vector<DepthTouch> depth_touched_;
+    std::uint64_t depth_epoch_ = 1;
+    std::uint64_t depth_sequence_ = 0;
+    std::shared_ptr<BroadcastRing<L3Event>> l3_ring_;
+    std::uint64_t l3_sequence_ = 0;
+    Timestamp command_time_ = 0;  // Set by each mutating call; 0 until needed
+    TopOfBook published_top_;
+    Seqlock<TopOfBook> top_of_book_;
+    std::uint64_t fill_sequence_ = 0;
     mutable std::mutex book_mutex;
 };
 
+// Maps symbol names to dense ids so per-symbol state can live in arrays.
+// intern must be serialized, which the engine does with engine_mutex;
+// find and name are safe from any thread without a lock.
+class SymbolRegistry {
+public:
+    explicit SymbolRegistry(std::size_t capacity) : names_(capacity) {}
+
+    // Returns the existing id, or assigns the next one; kInvalidSymbol
+    // once capacity names are registered
+    SymbolId intern(const std::string& symbol);
+    SymbolId find(std::string_view symbol) const;
+    // Names never move, so the reference stays valid
+    const std::string& name(SymbolId id) const { return names_[id].text; }
+    std::size_t size() const { return names_.size(); }
+
+private:
+    struct Name {
+        std::string text;
+        SymbolId id;
+    };
+
+    AppendOnlyArray<Name> names_;
+    PublishedIndex<const Name> index_;
+};
+
+// Net holding of one account in one symbol: positive long, negative short.
+// average_price is the cost of the open quantity only, so it resets when
+// the position goes flat and restarts at the fill price when it flips.
+struct Position {
+    int quantity = 0;
+    double average_price = 0.0;
+    double realized_pnl = 0.0;
+
+    // Books one execution in O(1)
+    void apply(bool is_buy, double price, int fill_quantity);
+    double unrealized_pnl(double mark_price) const {
+        return quantity * (mark_price - average_price);
+    }
+};
+
+// Positions by (account, symbol), fed from fills. Only the engine's
+// accounting thread writes, publishing each position through a seqlock.
+// Readers find positions through a PublishedIndex, so neither side ever
+// takes a lock or waits on the other, even when a position is added.
+class PositionKeeper {
+public:
+    // Books both sides of the fill. Single writer only.
+    void apply(SymbolId symbol, const Fill& fill);
+    // A flat Position if the account never traded the symbol
+    Position get(AccountId account, SymbolId symbol) const;
+    // get for each symbol; out must be at least as long as symbols
+    void get(AccountId account, std::span<const SymbolId> symbols, std::span<Position> out) const;
+
+    struct Entry {
+        AccountId account;
+        SymbolId symbol;
+        Position position;
+    };
+    // Every position ever opened, in the order they were opened. Writer
+    // only, like restore, which sets each position outright.
+    void save(std::vector<Entry>& out) const;
+    void restore(const std::vector<Entry>& entries);
+
+private:
+    struct Slot {
+        explicit Slot(std::uint64_t key) : key(key) {}
+
+        std::uint64_t key;
+        Position working;               // Writer's copy
+        Seqlock<Position> published;
+    };
+
+    static std::uint64_t key(AccountId account, SymbolId symbol) {
+        return (static_cast<std::uint64_t>(account) << 32) | symbol;
+    }
+    Slot* find(std::uint64_t slot_key) const {
+        return index_.find(slot_key, [slot_key](const Slot& slot) { return slot.key == slot_key; });
+    }
+    Slot& slot(AccountId account, SymbolId symbol);
+
+    // Slots never move once added, so the index can point into the deque
+    std::deque<Slot> slots_;
+    PublishedIndex<Slot> index_;
+};
+
+struct EngineConfig {
+    // Number of matching threads symbols are partitioned across. 0 matches
+    // inline on the submitting thread.
+    std::size_t matching_threads = 0;
+    // Optional core for each matching thread (thread i uses entry i % size)
+    std::vector<int> matching_cores;
+    // Upper bound on registered symbols; capped at kMaxSymbols
+    std::size_t max_symbols = std::size_t{1} << 16;
+    // Threads delivering market data to subscribers. 0 delivers on the
+    // market data thread itself (still outside engine_mutex).
+    std::size_t dispatch_threads = 1;
+    // Simulated ticks per second for each subscribed symbol, unless
+    // overridden with set_market_data_rate
+    double market_data_rate = 10.0;
+    // Stamp MarketData::monotonic_timestamp from the CPU timestamp counter
+    // instead of steady_clock. Needs an invariant TSC synchronized across
+    // cores (see tsc_clock_ns).
+    bool tsc_clock = false;
+    // Spin between ticks instead of sleeping, for load tests that need
+    // precise high rates and can spare a core
+    bool market_data_busy_spin = false;
+    // Slots in each matching or dispatch thread's lock-free ring
+    std::size_t queue_capacity = std::size_t{1} << 16;
+    // Events a symbol's L3 ring holds before slow readers are overrun. The
+    // ring is only allocated when the symbol's feed is first opened.
+    std::size_t l3_ring_capacity = std::size_t{1} << 16;
+    // Directory for the write-ahead command journal; empty disables it.
+    // Commands are journaled as they are applied, by a journal thread that
+    // group-commits them, so matching never waits on the disk. A journal
+    // already in the directory is replayed first (see RecoveryStats).
+    std::string journal_directory;
+    // Size each journal segment file is preallocated to
+    std::size_t journal_segment_bytes = std::size_t{64} << 20;
+    // Synchronous calls also wait for their command to reach the disk. Fills
+    // and feeds may still be published before it does.
+    bool journal_sync = false;
+    // Keep a replica of every book and position, fed from the journal by its
+    // own thread, and write snapshots of it to the journal directory. Taking
+    // a snapshot never pauses matching; recovery loads the newest one and
+    // only replays the journal after it. The two newest snapshots are kept,
+    // and journal segments older than both are deleted, so a journal
+    // written with snapshots on needs them to recover. Needs
+    // journal_directory.
+    bool snapshots = false;
+    // Seconds between automatic snapshots; 0 only writes them on request
+    double snapshot_interval_seconds = 0.0;
+};
+
+// An engine opened on a journal directory replays it before taking new
+// commands. Orders keep their journaled ids and fills their journaled
+// timestamps, so the rebuilt books, positions and feed sequences match the
+// ones that were lost.
+struct RecoveryStats {
+    std::uint64_t snapshot_sequence = 0;  // Journal sequence of the snapshot loaded, or 0
+    std::uint64_t replayed = 0;           // Journal records applied after it
+    std::uint64_t last_sequence = 0;      // New journal records continue after this
+    // Replay stopped at an unreadable segment or a sequence gap, so later
+    // commands were not applied. The segments from there on are renamed
+    // to journal-<index>.log.damaged and new commands follow on from
+    // last_sequence.
+    bool damaged = false;
+};
+
+struct MatchingShard;
+struct DispatchShard;
+struct AccountingShard;
+class Journal;
+class Snapshotter;
+struct SnapshotImage;
+class ExecutionEngine;
+
+// What the market data thread runs between start() and stop(). Without
+// one the engine simulates a random walk for every subscribed symbol.
+class MarketDataSource {
+public:
+    virtual ~MarketDataSource() = default;
+    // Called by start() before the run begins, so whatever progress the
+    // source reports is back at the start by the time start() returns
+    virtual void reset() {}
+    // Publishes ticks with engine.publish_market_data until it runs out or
+    // engine.market_data_running() turns false, which it should check
+    // between batches and while waiting
+    virtual void run(ExecutionEngine& engine) = 0;
+};
+
 class ExecutionEngine {
 public:
     ExecutionEngine();
+    // Throws std::system_error if a journal is configured and cannot be
+    // opened, holds more symbols than max_symbols allows, or was pruned by
+    // snapshots that cannot be loaded
+    explicit ExecutionEngine(const EngineConfig& config);
     ~ExecutionEngine();
 
     // Delete copy operations
@@ -107,31 +647,206 @@ public:
     ExecutionEngine(ExecutionEngine&&) = delete;
     ExecutionEngine& operator=(ExecutionEngine&&) = delete;
 
+    // Starts market data from the configured source, or the simulator.
+    // Calling start() again restarts it, including after a source has run
+    // to the end on its own.
     void start();
     void stop();
+    // Used by the next start(); null restores the simulator
+    void set_market_data_source(std::shared_ptr<MarketDataSource> source);
+    // False once stop() has been called
+    bool market_data_running() const { return running.load(std::memory_order_relaxed); }
+    // For market data sources, on the market data thread: delivers each
+    // tick to its registered symbol's subscribers, in order, through the
+    // dispatch threads if there are any, and stamps them all with the
+    // engine's monotonic clock. Ticks for ids that were never registered
+    // are dropped. Without dispatch threads a batch looks up each symbol's
+    // subscribers once, so large batches are what lets replay outrun the
+    // subscribers rather than the bookkeeping.
+    void publish_market_data(std::span<const SymbolId> symbols, std::span<MarketData> ticks);
 
+    // Resolve a symbol once and use the id on the hot path. Returns
+    // kInvalidSymbol once max_symbols symbols are registered. Only
+    // registering a new symbol takes engine_mutex.
+    SymbolId register_symbol(const std::string& symbol);
+    SymbolId find_symbol(const std::string& symbol) const;
+    // Registered ids are 0 .. symbol_count() - 1
+    std::size_t symbol_count() const { return order_books.size(); }
+
+    // Synchronous calls return once the owning matching thread has applied
+    // the command, so the book reflects it on return.
     std::string submit_order(const Order& order);
+    OrderId submit_order(const std::string& symbol, Price price, int quantity, bool is_buy,
+                         OrderType type = OrderType::Limit);
+    // Returns 0 if the symbol id was never registered. For Stop and
+    // StopLimit, price is both the trigger and the limit; use
+    // submit_stop_order to set them apart.
+    OrderId submit_order(SymbolId symbol, Price price, int quantity, bool is_buy,
+                         OrderType type = OrderType::Limit, AccountId account = kDefaultAccount);
+    // Limit order showing at most display_quantity at a time. Each refill
+    // from the reserve goes to the back of its price level.
+    OrderId submit_iceberg_order(SymbolId symbol, Price price, int quantity, bool is_buy,
+                                 int display_quantity, AccountId account = kDefaultAccount);
+    // Held off the book until a trade prints at or above stop_price (buys)
+    // or at or below it (sells), then entered as a market order, or as a
+    // limit order at limit_price for StopLimit. Returns 0 for other types.
+    OrderId submit_stop_order(SymbolId symbol, Price stop_price, int quantity, bool is_buy,
+                              OrderType type = OrderType::Stop, Price limit_price = 0,
+                              AccountId account = kDefaultAccount);
+    // Queues the order on its shard's ring and returns the pre-assigned id
+    // without waiting for matching. Returns 0 if the symbol is unknown or the
+    // ring is full. Without matching threads this matches inline.
+    OrderId submit_order_async(SymbolId symbol, Price price, int quantity, bool is_buy,
+                               OrderType type = OrderType::Limit, AccountId account = kDefaultAccount);
+    bool cancel_order(const std::string& order_id);
+    bool cancel_order(OrderId order_id);
+    // Price and/or quantity amend in one matching step; see OrderBook::modify
+    bool modify_order(const std::string& order_id, double price, int quantity);
+    bool modify_order(OrderId order_id, Price price, int quantity);
+    std::size_t cancel_all_orders(const std::string& symbol);
     
     void subscribe_market_data(const std::string& symbol, MarketDataCallback callback);
     void unsubscribe_market_data(const std::string& symbol);
+    // Ticks per second simulated for the symbol; 0 pauses it. Does not
+    // apply to a market data source.
+    void set_market_data_rate(const std::string& symbol, double ticks_per_second);
     
     void subscribe_trades(const std::string& symbol, TradeCallback callback);
     void unsubscribe_trades(const std::string& symbol);
 
+    // Level add/change/delete feed, delivered on the matching thread right
+    // after the command that caused it. Pair with get_depth to start.
+    void subscribe_depth(const std::string& symbol, DepthCallback callback);
+    void unsubscribe_depth(const std::string& symbol);
+    // Order-by-order feed for the symbol. The reader starts at the next
+    // event; ids that were never registered give a detached reader.
+    L3Reader open_l3_feed(const std::string& symbol);
+    L3Reader open_l3_feed(SymbolId symbol);
+
+    // Snapshot of at most levels per side under the book lock, with the
+    // sequence of the last update it includes
+    DepthSnapshot get_depth(const std::string& symbol, std::size_t levels) const;
+    // Reuses out's storage; leaves it empty for an unknown symbol
+    void get_depth(SymbolId symbol, std::size_t levels, DepthSnapshot& out) const;
+
+    // Positions are booked by the accounting thread, so they can trail a
+    // just-returned submit by the fills still in its queue. Unrealized P&L
+    // marks to the book's mid, or its last trade when a side is empty.
+    // The overloads without an account report kDefaultAccount. None of
+    // these wait on matching, accounting or any lock; the SymbolId
+    // overloads also skip the name lookup, so pollers should use them.
     int get_position(const std::string& symbol) const;
     double get_average_price(const std::string& symbol) const;
     double get_unrealized_pnl(const std::string& symbol) const;
     double get_realized_pnl(const std::string& symbol) const;
+    int get_position(AccountId account, const std::string& symbol) const;
+    double get_average_price(AccountId account, const std::string& symbol) const;
+    double get_unrealized_pnl(AccountId account, const std::string& symbol) const;
+    double get_realized_pnl(AccountId account, const std::string& symbol) const;
+    int get_position(AccountId account, SymbolId symbol) const;
+    double get_average_price(AccountId account, SymbolId symbol) const;
+    double get_unrealized_pnl(AccountId account, SymbolId symbol) const;
+    double get_realized_pnl(AccountId account, SymbolId symbol) const;
+    // Quantity, average price and realized P&L from one consistent snapshot
+    Position get_position_snapshot(AccountId account, SymbolId symbol) const;
+
+    // 0 for an empty side or an unknown symbol
+    double get_best_bid(const std::string& symbol) const;
+    double get_best_ask(const std::string& symbol) const;
+    double get_best_bid(SymbolId symbol) const;
+    double get_best_ask(SymbolId symbol) const;
+    TopOfBook get_top_of_book(SymbolId symbol) const;
+
+    // Batch forms for portfolio-wide polling; out must be at least as long
+    // as symbols. Every entry is a consistent snapshot of its own symbol,
+    // though symbols may be read at slightly different moments. Unknown
+    // ids read as flat positions and empty books.
+    void get_position_snapshots(AccountId account, std::span<const SymbolId> symbols,
+                                std::span<Position> out) const;
+    void get_top_of_books(std::span<const SymbolId> symbols, std::span<TopOfBook> out) const;
+
+    // errno of the write or sync that stopped the journal, or 0. Once set,
+    // nothing more is journaled and journal_sync calls stop waiting.
+    int journal_error() const;
+    // What the engine rebuilt itself from when it was opened on an existing
+    // journal directory
+    const RecoveryStats& recovery_stats() const;
+    // Writes a snapshot holding at least every command applied before the
+    // call and waits until it is on disk. Returns its journal sequence, or
+    // 0 if snapshots are off or it could not be written.
+    std::uint64_t snapshot();
 
 private:
+    friend struct MatchingShard;
+    friend struct DispatchShard;
+    friend struct AccountingShard;
+
+    struct MatchingCommand;
+
+    struct MarketDataEvent {
+        SymbolId symbol;
+        MarketData data;
+    };
+
+    struct FillEvent {
+        SymbolId symbol;
+        Fill fill;
+    };
+
     void market_data_thread_func();
+    void publish_market_data(const MarketDataEvent& event);
+    void deliver_market_data(const MarketDataEvent& event);
+    void dispatch_thread_func(DispatchShard& dispatcher);
+    void matching_thread_func(MatchingShard& shard);
+    void accounting_thread_func(AccountingShard& accounting);
+    // Runs a command on its shard and waits for the result
+    std::size_t execute(MatchingCommand command);
+    // Queues a command without waiting; false if the shard's ring is full
+    bool post(const MatchingCommand& command);
+    std::size_t apply_command(const MatchingCommand& command);
+    // Queues the command on the journal before it is applied
+    void journal_command(const MatchingCommand& command, Timestamp time);
+    // Rebuilds books and positions from the newest snapshot and the journal
+    // after it, on the constructing thread
+    void recover_from_journal();
+    // Copies the whole engine; only while no matching thread is running
+    void save_state(SnapshotImage& image) const;
+    void restore_state(const SnapshotImage& image);
+    // For a journal or snapshot holding ids past max_symbols
+    [[noreturn]] void throw_symbols_do_not_fit() const;
+    void publish_fills(SymbolId symbol, const std::vector<Fill>& fills);
+    void publish_depth(SymbolId symbol, const std::vector<DepthUpdate>& depth);
+    // Hands fills to the accounting thread so matching never waits on it
+    void record_fills(SymbolId symbol, const std::vector<Fill>& fills);
+    SymbolId register_symbol_locked(const std::string& symbol);
 
+    EngineConfig config;
     std::atomic<bool> running{false};
     std::thread market_data_thread;
+    std::shared_ptr<MarketDataSource> market_data_source;
     
-    std::unordered_map<std::string, OrderBook> order_books;
-    std::unordered_map<std::string, std::vector<MarketDataCallback>> market_data_callbacks;
-    std::unordered_map<std::string, std::vector<TradeCallback>> trade_callbacks;
+    // Per-symbol state is indexed by SymbolId. Books never move once
+    // registered, so matching threads index them without engine_mutex.
+    SymbolRegistry symbols;
+    AppendOnlyArray<OrderBook> order_books;
+    AppendOnlyArray<SubscriberList<MarketDataCallback>> market_data_callbacks;
+    AppendOnlyArray<std::atomic<double>> market_data_rates;
+    AppendOnlyArray<SubscriberList<TradeCallback>> trade_callbacks;
+    AppendOnlyArray<SubscriberList<DepthCallback>> depth_callbacks;
+    // Without matching threads, held across journaling and applying a
+    // command so the journal has each symbol's commands in book order
+    AppendOnlyArray<std::mutex> journal_sequencers;
+
+    // Symbol id modulo shard count picks the matching thread
+    std::vector<std::unique_ptr<MatchingShard>> shards;
+    // Market data fans out to these by symbol id, off the engine lock
+    std::vector<std::unique_ptr<DispatchShard>> dispatchers;
+    PositionKeeper positions;
+    std::unique_ptr<AccountingShard> accounting;
+    std::unique_ptr<Journal> journal;
+    std::unique_ptr<Snapshotter> snapshotter;
+    RecoveryStats recovery;
+    std::atomic<std::uint64_t> next_order_sequence{1};
     
     mutable std::mutex engine_mutex;
 };
@@ -0,0 +1,213 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include "execution_engine.hpp"
+#include "ring_buffer.hpp"
+
+namespace trading {
+
+// One inbound command as the matching path applied it. Every byte is a
+// named field so records can be checksummed and read back as raw bytes.
+struct JournalRecord {
+    enum class Type : std::uint8_t {
+        RegisterSymbol,  // symbol is the new id; the name follows the record
+        Submit,          // All order fields are used
+        Cancel,          // order_id only
+        Modify,          // order_id, price and quantity
+        CancelAll,       // symbol only
+    };
+
+    std::uint64_t sequence;   // Journal-wide, starting at first_sequence
+    Timestamp timestamp;      // Wall clock when the command was applied
+    OrderId order_id;
+    Price price;
+    Price stop_price;
+    std::int32_t quantity;
+    std::int32_t display_quantity;
+    AccountId account;
+    SymbolId symbol;
+    Type type;
+    OrderType order_type;
+    bool is_buy;
+    std::uint8_t reserved[5];
+};
+
+static_assert(sizeof(JournalRecord) == 64, "JournalRecord is a fixed on-disk layout");
+
+// On-disk framing. A segment starts with a JournalSegmentHeader and is
+// followed by entries, each a JournalEntryHeader and size bytes of payload:
+// a JournalRecord plus, for RegisterSymbol, the symbol name. Segments are
+// preallocated with zeros, so a zero size marks the end of the written
+// part; a bad checksum marks a write torn by a crash.
+struct JournalSegmentHeader {
+    char magic[8];
+    std::uint32_t version;
+    std::uint32_t reserved;
+    std::uint64_t segment_index;
+    std::uint64_t first_sequence;
+};
+
+struct JournalEntryHeader {
+    std::uint32_t size;
+    std::uint32_t checksum;
+};
+
+inline constexpr char kJournalMagic[8] = {'T', 'R', 'D', 'J', 'R', 'N', 'L', '\0'};
+inline constexpr std::uint32_t kJournalVersion = 1;
+
+// FNV-1a over an entry's payload, a word at a time so that checking it
+// keeps up with sequential reads
+std::uint32_t journal_checksum(const void* data, std::size_t size);
+
+// Applies a journaled command to its book at its journaled time, appending
+// the fills it produced. Not for RegisterSymbol.
+void replay_record(const JournalRecord& record, OrderBook& book, std::vector<Fill>& fills);
+
+// "<directory>/journal-<index>.log", with the index zero padded so the
+// files sort in write order
+std::string journal_segment_path(const std::string& directory, std::uint64_t segment_index);
+
+// Deletes the segments holding nothing after sequence, which a snapshot
+// at sequence makes redundant. The newest segment is always kept, as are
+// segments set aside as damaged. Returns how many were deleted.
+std::size_t prune_journal(const std::string& directory, std::uint64_t sequence);
+
+// Append-only command log written by its own thread. Producers only copy a
+// record into a lock-free ring; the journal thread drains whatever has
+// queued into one write and one fdatasync (group commit), so a burst of
+// commands costs a single disk flush. A run carries on in the newest
+// segment if it ends where the run starts, and otherwise writes fresh
+// segments after any already in the directory, including ones set aside
+// as damaged. Segments are trimmed to their entries when closed.
+class Journal {
+public:
+    // Called on the journal thread with each entry once it is on disk, in
+    // sequence order; name is only set for RegisterSymbol
+    using Tap = std::function<void(const JournalRecord& record, const std::string* name)>;
+
+    // Throws std::system_error if the directory or first segment cannot be
+    // created
+    Journal(const std::string& directory, std::size_t segment_bytes, std::size_t queue_capacity,
+            std::uint64_t first_sequence = 1, Tap tap = {});
+    // Drains, syncs, trims and closes the current segment
+    ~Journal();
+
+    Journal(const Journal&) = delete;
+    Journal& operator=(const Journal&) = delete;
+
+    // Safe from any number of threads; waits only if the ring is full.
+    // Fills in record.sequence and returns it. Records with the same
+    // symbol must be appended in the order they are applied.
+    std::uint64_t append(JournalRecord& record);
+    // name must stay valid until the journal has written it
+    std::uint64_t append_symbol(SymbolId symbol, const std::string& name);
+
+    // Blocks until sequence is on disk. Returns false if the journal has
+    // failed instead, in which case it will never be.
+    bool wait_durable(std::uint64_t sequence) const;
+    // Sequence of the last record appended, written or not
+    std::uint64_t appended_sequence() const { return first_sequence_ + queue_.pushed() - 1; }
+    // Highest sequence known to be on disk; first_sequence - 1 before any
+    std::uint64_t durable_sequence() const { return durable_.load(std::memory_order_acquire); }
+    // errno of the write or sync that stopped the journal, or 0
+    int error() const { return error_.load(std::memory_order_acquire); }
+
+private:
+    struct Entry {
+        JournalRecord record;
+        const std::string* name;  // RegisterSymbol only
+    };
+
+    void thread_func();
+    // Frames the entry into batch_, first flushing and rolling to the next
+    // segment if it would not fit in this one
+    void write_entry(const Entry& entry);
+    bool open_segment(std::uint64_t segment_index);
+    // Continues an existing segment after its last intact entry, if that
+    // entry is the one just before first_sequence and there is room left
+    bool reopen_segment(std::uint64_t segment_index, const std::string& path);
+    // Trims the current segment to its entries and closes it
+    void close_segment();
+    // Writes batch_ at the end of the segment, syncs it and passes its
+    // entries to the tap
+    bool flush_batch();
+    // Keeps the first error
+    void fail(int error);
+
+    std::string directory_;
+    std::size_t segment_bytes_;
+    std::uint64_t first_sequence_;
+    MpscRingBuffer<Entry> queue_;
+    Tap tap_;
+
+    // Journal thread only
+    int fd_ = -1;
+    std::uint64_t segment_index_ = 0;
+    std::size_t segment_offset_ = 0;
+    std::uint64_t next_sequence_;
+    std::vector<char> batch_;
+    std::vector<Entry> batch_entries_;  // What batch_ holds, if there is a tap
+
+    std::thread thread_;
+    std::atomic<bool> stopping_{false};
+    std::atomic<std::uint64_t> durable_;
+    std::atomic<int> error_{0};
+    // Bumped after every group commit, successful or not; waiters sleep on it
+    std::atomic<std::uint64_t> flushes_{0};
+};
+
+// Reads a journal directory back in sequence order. Each segment is mapped
+// read-only and walked sequentially in place, so records are never copied
+// through a read buffer. A segment ends at its first unwritten or torn
+// entry; reading carries on into the next segment only if its sequence
+// follows on, which is what a run after a crash writes.
+class JournalReader {
+public:
+    // A missing directory reads as an empty journal
+    explicit JournalReader(const std::string& directory);
+    ~JournalReader();
+
+    JournalReader(const JournalReader&) = delete;
+    JournalReader& operator=(const JournalReader&) = delete;
+
+    // Next intact entry; false at the end of the log. For RegisterSymbol,
+    // name views the symbol inside the mapping until the next call.
+    bool next(JournalRecord& record, std::string_view& name);
+    // Skips whole segments that hold nothing after sequence. Call before
+    // the first next(); entries up to sequence may still be returned.
+    void skip_to(std::uint64_t sequence);
+
+    // Sequence of the last entry returned, or 0
+    std::uint64_t last_sequence() const { return last_sequence_; }
+    // True if reading stopped at a segment that is unreadable or does not
+    // follow on from the one before, leaving later segments unread
+    bool damaged() const { return damaged_; }
+    // Renames the segment reading stopped in, and every one after it, to
+    // "<segment>.damaged", so a journal opened afterwards follows on from
+    // the last entry read instead of after segments no reader gets past.
+    // Returns 0 or an errno value.
+    int set_aside_unread();
+
+private:
+    bool open_segment(std::size_t index);
+    void close_segment();
+
+    std::string directory_;
+    std::vector<std::string> segments_;  // In index order
+    std::size_t next_segment_ = 0;
+    const char* data_ = nullptr;
+    std::size_t size_ = 0;
+    std::size_t offset_ = 0;
+    std::uint64_t last_sequence_ = 0;
+    bool damaged_ = false;
+};
+
+} // namespace trading
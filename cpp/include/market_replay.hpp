@@ -0,0 +1,43 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "execution_engine.hpp"
+
+namespace trading {
+
+// Replays a tick store through the engine in place of the simulator.
+// Symbols are merged into one stream by original timestamp, read straight
+// from the store's mappings and published in batches. With speed 1 the gaps
+// between ticks are kept, with speed 10 they shrink tenfold, and with
+// speed 0 ticks go out as fast as subscribers take them. Each start()
+// replays the store from the beginning. Use with dispatch_threads = 0 for
+// the highest unthrottled rate, so ticks are delivered on the replay
+// thread instead of through the dispatch rings.
+class ReplayMarketData : public MarketDataSource {
+public:
+    // Replays every symbol in the store unless symbols are given
+    explicit ReplayMarketData(const std::string& directory, double speed = 1.0,
+                              std::vector<std::string> symbols = {});
+
+    void reset() override;
+    void run(ExecutionEngine& engine) override;
+
+    // Ticks published by the current or last run; both of these start over
+    // when start() is called
+    std::uint64_t published() const { return published_.load(std::memory_order_relaxed); }
+    // True once a run has published every tick, rather than being stopped
+    bool finished() const { return finished_.load(std::memory_order_acquire); }
+
+private:
+    std::string directory_;
+    double speed_;
+    std::vector<std::string> symbols_;
+    std::atomic<std::uint64_t> published_{0};
+    std::atomic<bool> finished_{false};
+};
+
+} // namespace trading
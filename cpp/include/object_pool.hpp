@@ -0,0 +1,69 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace trading {
+
+// Slab allocator for fixed-size objects. Memory is taken from the heap a
+// slab at a time and released objects go on a free list, so once the pool
+// has grown to its working size, create/destroy never allocate.
+// Not synchronized; each pool belongs to a single book.
+template <typename T>
+class ObjectPool {
+    // Live objects are simply dropped with their slab on destruction
+    static_assert(std::is_trivially_destructible_v<T>, "ObjectPool requires trivially destructible types");
+
+public:
+    explicit ObjectPool(std::size_t slab_size = 1024) : slab_size_(slab_size) {}
+
+    ObjectPool(const ObjectPool&) = delete;
+    ObjectPool& operator=(const ObjectPool&) = delete;
+
+    template <typename... Args>
+    T* create(Args&&... args) {
+        if (!free_list_) {
+            grow();
+        }
+        Slot* slot = free_list_;
+        free_list_ = slot->next;
+        ++in_use_;
+        return ::new (static_cast<void*>(slot->storage)) T{std::forward<Args>(args)...};
+    }
+
+    void destroy(T* object) {
+        Slot* slot = reinterpret_cast<Slot*>(object);
+        slot->next = free_list_;
+        free_list_ = slot;
+        --in_use_;
+    }
+
+    std::size_t in_use() const { return in_use_; }
+    std::size_t capacity() const { return slabs_.size() * slab_size_; }
+
+private:
+    union Slot {
+        Slot* next;
+        alignas(T) unsigned char storage[sizeof(T)];
+    };
+
+    void grow() {
+        slabs_.push_back(std::make_unique<Slot[]>(slab_size_));
+        Slot* slab = slabs_.back().get();
+        for (std::size_t i = 0; i < slab_size_; ++i) {
+            slab[i].next = free_list_;
+            free_list_ = &slab[i];
+        }
+    }
+
+    std::size_t slab_size_;
+    std::vector<std::unique_ptr<Slot[]>> slabs_;
+    Slot* free_list_ = nullptr;
+    std::size_t in_use_ = 0;
+};
+
+} // namespace trading
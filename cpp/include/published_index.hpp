@@ -0,0 +1,104 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace trading {
+
+// Hash index from 64-bit hashes to pointers, for one writer and any number
+// of readers that never lock. An entry's hash is stored before its pointer
+// is released, so a reader that sees the pointer sees the hash. A table
+// that fills past half is not grown in place: the writer copies it into
+// one twice the size and swaps that in. Replaced tables stay allocated
+// for the index's lifetime, at most as much again as the current one, so
+// a reader still probing one never follows a dangling pointer.
+template <typename T>
+class PublishedIndex {
+public:
+    PublishedIndex() { replace(kInitialCapacity); }
+
+    PublishedIndex(const PublishedIndex&) = delete;
+    PublishedIndex& operator=(const PublishedIndex&) = delete;
+
+    // Single writer. value must outlive the index and not be present yet.
+    void insert(std::uint64_t hash, T* value) {
+        if (2 * (size_ + 1) > tables_.back()->capacity) {
+            replace(2 * tables_.back()->capacity);
+        }
+        place(*tables_.back(), hash, value);
+        ++size_;
+    }
+
+    // Safe from any thread: the value with this hash that match accepts,
+    // or nullptr. An insert racing the lookup may or may not be seen.
+    template <typename Match>
+    T* find(std::uint64_t hash, Match&& match) const {
+        const Table* table = current_.load(std::memory_order_acquire);
+        for (std::size_t i = mix(hash) & (table->capacity - 1);; i = (i + 1) & (table->capacity - 1)) {
+            T* value = table->entries[i].value.load(std::memory_order_acquire);
+            if (value == nullptr) {
+                return nullptr;
+            }
+            if (table->entries[i].hash.load(std::memory_order_relaxed) == hash && match(*value)) {
+                return value;
+            }
+        }
+    }
+
+private:
+    static constexpr std::size_t kInitialCapacity = 64;
+
+    struct Entry {
+        std::atomic<std::uint64_t> hash{0};
+        std::atomic<T*> value{nullptr};
+    };
+
+    struct Table {
+        explicit Table(std::size_t capacity) : capacity(capacity), entries(std::make_unique<Entry[]>(capacity)) {}
+
+        std::size_t capacity;  // Power of two
+        std::unique_ptr<Entry[]> entries;
+    };
+
+    // Spreads keys that differ only in high bits, such as packed ids
+    static std::size_t mix(std::uint64_t hash) {
+        hash ^= hash >> 33;
+        hash *= 0xff51afd7ed558ccdull;
+        hash ^= hash >> 33;
+        return static_cast<std::size_t>(hash);
+    }
+
+    // Linear probing; tables are never more than half full, so a free
+    // entry is always found
+    static void place(Table& table, std::uint64_t hash, T* value) {
+        std::size_t i = mix(hash) & (table.capacity - 1);
+        while (table.entries[i].value.load(std::memory_order_relaxed) != nullptr) {
+            i = (i + 1) & (table.capacity - 1);
+        }
+        table.entries[i].hash.store(hash, std::memory_order_relaxed);
+        table.entries[i].value.store(value, std::memory_order_release);
+    }
+
+    void replace(std::size_t capacity) {
+        auto table = std::make_unique<Table>(capacity);
+        if (!tables_.empty()) {
+            const Table& old = *tables_.back();
+            for (std::size_t i = 0; i < old.capacity; ++i) {
+                if (T* value = old.entries[i].value.load(std::memory_order_relaxed)) {
+                    place(*table, old.entries[i].hash.load(std::memory_order_relaxed), value);
+                }
+            }
+        }
+        current_.store(table.get(), std::memory_order_release);
+        tables_.push_back(std::move(table));
+    }
+
+    std::atomic<const Table*> current_{nullptr};
+    std::vector<std::unique_ptr<Table>> tables_;  // Writer only; current last
+    std::size_t size_ = 0;
+};
+
+} // namespace trading
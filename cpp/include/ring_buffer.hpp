@@ -0,0 +1,96 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+
+namespace trading {
+
+// Bounded lock-free multi-producer / single-consumer queue. Each slot
+// carries a sequence number that tells producers and the consumer whose
+// turn it is, so neither side ever takes a lock (Vyukov's bounded queue).
+template <typename T>
+class MpscRingBuffer {
+public:
+    // Capacity is rounded up to a power of two
+    explicit MpscRingBuffer(std::size_t capacity)
+        : capacity_(round_up_pow2(capacity)),
+          mask_(capacity_ - 1),
+          slots_(std::make_unique<Slot[]>(capacity_)) {
+        for (std::size_t i = 0; i < capacity_; ++i) {
+            slots_[i].sequence.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    MpscRingBuffer(const MpscRingBuffer&) = delete;
+    MpscRingBuffer& operator=(const MpscRingBuffer&) = delete;
+
+    // Safe from any number of threads. Returns false when the ring is full.
+    bool try_push(const T& value) {
+        std::size_t position;
+        return try_push(value, position);
+    }
+
+    // As above, also reporting the value's position: the number of values
+    // pushed before it, which is also the order they are popped in
+    bool try_push(const T& value, std::size_t& position) {
+        position = head_.load(std::memory_order_relaxed);
+        while (true) {
+            Slot& slot = slots_[position & mask_];
+            std::size_t sequence = slot.sequence.load(std::memory_order_acquire);
+            auto diff = static_cast<std::ptrdiff_t>(sequence) - static_cast<std::ptrdiff_t>(position);
+            if (diff == 0) {
+                if (head_.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) {
+                    slot.value = value;
+                    slot.sequence.store(position + 1, std::memory_order_release);
+                    return true;
+                }
+            } else if (diff < 0) {
+                return false;
+            } else {
+                position = head_.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    // Consumer thread only. Returns false when the ring is empty.
+    bool try_pop(T& value) {
+        Slot& slot = slots_[tail_ & mask_];
+        std::size_t sequence = slot.sequence.load(std::memory_order_acquire);
+        if (sequence != tail_ + 1) {
+            return false;
+        }
+        value = slot.value;
+        slot.sequence.store(tail_ + capacity_, std::memory_order_release);
+        ++tail_;
+        return true;
+    }
+
+    // Values pushed or being pushed so far; the next push's position
+    std::size_t pushed() const { return head_.load(std::memory_order_acquire); }
+
+    std::size_t capacity() const { return capacity_; }
+
+private:
+    struct Slot {
+        std::atomic<std::size_t> sequence;
+        T value;
+    };
+
+    static std::size_t round_up_pow2(std::size_t value) {
+        std::size_t result = 1;
+        while (result < value) {
+            result <<= 1;
+        }
+        return result;
+    }
+
+    std::size_t capacity_;
+    std::size_t mask_;
+    std::unique_ptr<Slot[]> slots_;
+    // Producers and the consumer each get their own cache line
+    alignas(64) std::atomic<std::size_t> head_{0};
+    alignas(64) std::size_t tail_ = 0;
+};
+
+} // namespace trading
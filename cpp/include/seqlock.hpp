@@ -0,0 +1,69 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <thread>
+#include <type_traits>
+
+namespace trading {
+
+// Single-writer snapshot of a small trivially copyable value. The writer
+// never waits; a reader retries if it overlapped a store, so it always
+// returns a value that was stored as a whole. The payload is kept in
+// atomic words so torn reads are detected, not undefined behaviour.
+template <typename T>
+class Seqlock {
+    static_assert(std::is_trivially_copyable_v<T>, "Seqlock requires trivially copyable types");
+
+public:
+    Seqlock() { store(T{}); }
+
+    Seqlock(const Seqlock&) = delete;
+    Seqlock& operator=(const Seqlock&) = delete;
+
+    // Stores must be serialized by the caller
+    void store(const T& value) {
+        std::uint64_t words[kWords] = {};
+        std::memcpy(words, &value, sizeof(T));
+
+        std::uint64_t sequence = sequence_.load(std::memory_order_relaxed);
+        sequence_.store(sequence + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        for (std::size_t i = 0; i < kWords; ++i) {
+            words_[i].store(words[i], std::memory_order_relaxed);
+        }
+        sequence_.store(sequence + 2, std::memory_order_release);
+    }
+
+    // Safe from any number of threads
+    T load() const {
+        std::uint64_t words[kWords];
+        while (true) {
+            std::uint64_t before = sequence_.load(std::memory_order_acquire);
+            if (before & 1) {
+                std::this_thread::yield();
+                continue;
+            }
+            for (std::size_t i = 0; i < kWords; ++i) {
+                words[i] = words_[i].load(std::memory_order_relaxed);
+            }
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (sequence_.load(std::memory_order_relaxed) == before) {
+                break;
+            }
+        }
+        T value;
+        std::memcpy(&value, words, sizeof(T));
+        return value;
+    }
+
+private:
+    static constexpr std::size_t kWords = (sizeof(T) + sizeof(std::uint64_t) - 1) / sizeof(std::uint64_t);
+
+    std::atomic<std::uint64_t> sequence_{0};
+    std::atomic<std::uint64_t> words_[kWords] = {};
+};
+
+} // namespace trading
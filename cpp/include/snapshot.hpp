@@ -0,0 +1,111 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "execution_engine.hpp"
+#include "journal.hpp"
+#include "ring_buffer.hpp"
+
+namespace trading {
+
+// Everything a snapshot holds: the state after applying every journal
+// record up to sequence
+struct SnapshotImage {
+    struct Symbol {
+        std::string name;
+        BookState book;
+    };
+
+    std::uint64_t sequence = 0;
+    std::uint64_t next_order_sequence = 1;
+    Timestamp taken_at = 0;
+    std::vector<Symbol> symbols;  // Indexed by SymbolId
+    std::vector<PositionKeeper::Entry> positions;
+};
+
+// "<directory>/snapshot-<sequence>.snap", zero padded so names sort by
+// sequence
+std::string snapshot_path(const std::string& directory, std::uint64_t sequence);
+// Writes and syncs a temporary file, then renames it into place, so a
+// crash never leaves a partial snapshot under a snapshot name. Returns 0
+// or an errno value.
+int write_snapshot(const std::string& directory, const SnapshotImage& image);
+// Newest snapshot in the directory that reads back intact; false if there
+// is none
+bool load_latest_snapshot(const std::string& directory, SnapshotImage& image);
+
+// Keeps a replica of every book and position on its own thread, fed each
+// journal record once it is durable, and snapshots the replica. Matching
+// never stops for a snapshot: only the replica pauses while it is copied,
+// and the records that arrive meanwhile queue up for it. Copies alternate
+// between two images, so one can be filled while a writer thread is still
+// putting the other on disk.
+class Snapshotter {
+public:
+    // The replica starts as image, which must be the engine's state as of
+    // the journal sequence it is opened at
+    Snapshotter(const std::string& directory, const SnapshotImage& image, std::size_t queue_capacity,
+                double interval_seconds);
+    ~Snapshotter();
+
+    Snapshotter(const Snapshotter&) = delete;
+    Snapshotter& operator=(const Snapshotter&) = delete;
+
+    // Journal thread only, in sequence order. name is set for
+    // RegisterSymbol and must outlive the snapshotter.
+    void feed(const JournalRecord& record, const std::string* name);
+    // Waits for a snapshot that includes sequence to be on disk. Returns
+    // its sequence, or 0 if it could not be written.
+    std::uint64_t take(std::uint64_t sequence);
+
+private:
+    struct Entry {
+        JournalRecord record;
+        const std::string* name;
+    };
+
+    struct Request {
+        std::uint64_t sequence;
+        std::promise<std::uint64_t>* result;
+    };
+
+    void thread_func();
+    void apply(const Entry& entry);
+    // Copies the replica and hands it to the writer thread along with the
+    // requests it satisfies
+    void start_snapshot(std::vector<Request> requests);
+
+    std::string directory_;
+    double interval_seconds_;
+    MpscRingBuffer<Entry> queue_;
+
+    // Snapshot thread only
+    std::vector<std::unique_ptr<OrderBook>> books_;
+    PositionKeeper positions_;
+    std::vector<Fill> fills_;
+    std::uint64_t sequence_;
+    std::uint64_t next_order_sequence_;
+    std::uint64_t last_snapshot_ = 0;
+    SnapshotImage images_[2];
+    int next_image_ = 0;
+    std::thread writer_;  // Reads the image it was started with
+
+    std::mutex requests_mutex_;
+    std::vector<Request> requests_;
+    // Lowest sequence any waiting request needs, so the replica can check
+    // for requests without taking the mutex
+    std::atomic<std::uint64_t> lowest_request_;
+
+    std::thread thread_;
+    std::atomic<bool> stopping_{false};
+};
+
+} // namespace trading
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <utility>
+#include <vector>
+
+namespace trading {
+
+// Copy-on-write list of callbacks. Subscribing copies the list and swaps
+// the new one in atomically; dispatchers take a snapshot and walk it with
+// no lock held, so user callbacks never run under an engine or book lock.
+template <typename Callback>
+class SubscriberList {
+public:
+    using Snapshot = std::shared_ptr<const std::vector<Callback>>;
+
+    // Writers must be serialized by the caller
+    void add(Callback callback) {
+        auto current = snapshot();
+        auto updated = current ? std::make_shared<std::vector<Callback>>(*current)
+                               : std::make_shared<std::vector<Callback>>();
+        updated->push_back(std::move(callback));
+        callbacks_.store(Snapshot(std::move(updated)), std::memory_order_release);
+    }
+
+    void clear() {
+        callbacks_.store(Snapshot(), std::memory_order_release);
+    }
+
+    // Null when nobody is subscribed
+    Snapshot snapshot() const {
+        return callbacks_.load(std::memory_order_acquire);
+    }
+
+private:
+    std::atomic<Snapshot> callbacks_;
+};
+
+} // namespace trading
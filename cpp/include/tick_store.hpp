@@ -0,0 +1,143 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "execution_engine.hpp"
+
+namespace trading {
+
+// On-disk tick store: one directory per symbol holding a column file per
+// field, each a TickColumnHeader followed by fixed-width values. Row i of
+// a symbol is entry i of every column, so a scan over one field touches
+// only that field's pages.
+struct TickColumnHeader {
+    char magic[8];
+    std::uint32_t version;
+    std::uint32_t width;   // Bytes per value
+    std::uint64_t count;   // Values written; bumped only once they are in place
+    std::uint8_t reserved[40];
+};
+
+static_assert(sizeof(TickColumnHeader) == 64, "TickColumnHeader is a fixed on-disk layout");
+
+inline constexpr char kTickMagic[8] = {'T', 'R', 'D', 'T', 'I', 'C', 'K', '\0'};
+inline constexpr std::uint32_t kTickVersion = 1;
+
+// "<directory>/<symbol>", with bytes that are unsafe in a file name
+// escaped as %XX
+std::string tick_store_symbol_path(const std::string& directory, const std::string& symbol);
+// Symbols with data in the store, sorted
+std::vector<std::string> tick_store_symbols(const std::string& directory);
+
+struct TickImportStats {
+    std::uint64_t imported = 0;
+    std::uint64_t skipped = 0;  // Lines that did not parse, header included
+};
+
+// Appends the ticks in a CSV file to the store. Each line is
+// symbol,timestamp,price,volume, with the timestamp in integer
+// nanoseconds since the epoch or in decimal seconds. Throws
+// std::system_error if the file cannot be read or a symbol's columns
+// cannot be opened.
+TickImportStats import_ticks_csv(const std::string& csv_path, const std::string& directory);
+
+// Appends one symbol's ticks to its columns through shared mappings, so an
+// append is three stores and no system call. Files grow by doubling and
+// are trimmed to their contents on close. Opening a symbol that already
+// has data appends after it. Single writer per symbol.
+class TickWriter {
+public:
+    // Throws std::system_error if the columns cannot be created or mapped
+    TickWriter(const std::string& directory, const std::string& symbol);
+    ~TickWriter();
+
+    TickWriter(const TickWriter&) = delete;
+    TickWriter& operator=(const TickWriter&) = delete;
+
+    // Ticks are expected in arrival order. Returns false if the columns
+    // could not grow, in which case the tick is not recorded.
+    bool append(Timestamp timestamp, double price, double volume);
+    bool append(const MarketData& tick) { return append(tick.timestamp, tick.price, tick.volume); }
+    // Blocks until everything appended so far is on disk
+    bool sync();
+
+    std::size_t size() const { return count_; }
+    const std::string& symbol() const { return symbol_; }
+
+private:
+    struct Column {
+        int fd = -1;
+        char* data = nullptr;  // Mapping, header included
+        std::size_t mapped = 0;
+    };
+
+    bool grow(std::size_t capacity);
+
+    std::string symbol_;
+    Column columns_[3];  // Timestamp, price, volume
+    std::size_t count_ = 0;
+    std::size_t capacity_ = 0;
+};
+
+// Maps one symbol's columns read-only and hands out spans straight over
+// the mappings. Sees the ticks written when it was opened; a missing or
+// damaged store reads as empty.
+class TickReader {
+public:
+    TickReader(const std::string& directory, const std::string& symbol);
+    ~TickReader();
+
+    TickReader(const TickReader&) = delete;
+    TickReader& operator=(const TickReader&) = delete;
+
+    std::size_t size() const { return count_; }
+    bool empty() const { return count_ == 0; }
+    // Valid for the reader's lifetime
+    std::span<const Timestamp> timestamps() const { return {column<Timestamp>(0), count_}; }
+    std::span<const double> prices() const { return {column<double>(1), count_}; }
+    std::span<const double> volumes() const { return {column<double>(2), count_}; }
+    const std::string& symbol() const { return symbol_; }
+
+private:
+    template <typename T>
+    const T* column(std::size_t index) const {
+        return data_[index] ? reinterpret_cast<const T*>(data_[index] + sizeof(TickColumnHeader)) : nullptr;
+    }
+
+    std::string symbol_;
+    const char* data_[3] = {};
+    std::size_t mapped_[3] = {};
+    std::size_t count_ = 0;
+};
+
+// Records the live market data stream into a tick store. Each symbol gets
+// its own TickWriter behind its own callback, so recording never looks a
+// symbol up per tick and never takes a lock: one symbol's ticks are
+// always delivered on one thread.
+class TickRecorder {
+public:
+    explicit TickRecorder(const std::string& directory);
+
+    // Pass to subscribe_market_data for the same symbol. The recorder must
+    // outlive the subscription. Throws std::system_error like TickWriter.
+    MarketDataCallback callback(const std::string& symbol);
+
+    // Ticks that could not be recorded because a column could not grow
+    std::uint64_t dropped() const { return dropped_.load(std::memory_order_relaxed); }
+
+private:
+    std::string directory_;
+    std::atomic<std::uint64_t> dropped_{0};
+    std::mutex mutex_;
+    std::unordered_map<std::string, std::unique_ptr<TickWriter>> writers_;
+};
+
+} // namespace trading
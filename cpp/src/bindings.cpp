@@ -3,6 +3,8 @@
 #include <memory>
 #include <unordered_map>
 #include <mutex>
+#include <algorithm>
+#include <vector>
 
 namespace {
     std::unique_ptr<trading::ExecutionEngine> engine;
@@ -15,6 +17,37 @@ namespace {
         auto [it, inserted] = string_cache.emplace(str, str);
         return it->first.c_str();
     }
+
+    // Scratch for the batch getters, reused so polling does not allocate
+    thread_local std::vector<trading::SymbolId> batch_symbols;
+    thread_local std::vector<trading::Position> batch_positions;
+    thread_local std::vector<trading::TopOfBook> batch_books;
+    thread_local trading::DepthSnapshot depth_snapshot;
+
+    int fill_positions(trading::ExecutionEngine* engine_ptr, unsigned int account,
+                       int* positions, double* average_prices, double* realized_pnls,
+                       double* unrealized_pnls) {
+        std::size_t count = batch_symbols.size();
+        batch_positions.resize(count);
+        engine_ptr->get_position_snapshots(static_cast<trading::AccountId>(account), batch_symbols, batch_positions);
+        if (unrealized_pnls) {
+            batch_books.resize(count);
+            engine_ptr->get_top_of_books(batch_symbols, batch_books);
+        }
+
+        for (std::size_t i = 0; i < count; ++i) {
+            const trading::Position& position = batch_positions[i];
+            if (positions) positions[i] = position.quantity;
+            if (average_prices) average_prices[i] = position.average_price;
+            if (realized_pnls) realized_pnls[i] = position.realized_pnl;
+            if (unrealized_pnls) {
+                unrealized_pnls[i] = position.quantity != 0
+                    ? position.unrealized_pnl(batch_books[i].mark_price())
+                    : 0.0;
+            }
+        }
+        return static_cast<int>(count);
+    }
 }
 
 extern "C" {
@@ -48,6 +81,11 @@ void stop_engine(trading::ExecutionEngine* engine_ptr) {
     }
 }
 
+int register_symbol(trading::ExecutionEngine* engine_ptr, const char* symbol) {
+    if (!engine_ptr || !symbol) return -1;
+    return static_cast<int>(engine_ptr->register_symbol(symbol));
+}
+
 const char* submit_order(trading::ExecutionEngine* engine_ptr, const char* symbol, double price, int quantity, int side) {
     if (!engine_ptr || !symbol) return nullptr;
 
@@ -63,9 +101,148 @@ const char* submit_order(trading::ExecutionEngine* engine_ptr, const char* symbo
     return cache_string(order_id);
 }
 
+const char* submit_order_by_id(trading::ExecutionEngine* engine_ptr, int symbol_id, double price, int quantity, int side, int order_type) {
+    if (!engine_ptr || symbol_id < 0) return nullptr;
+    if (order_type < 0 || order_type > static_cast<int>(trading::OrderType::StopLimit)) return nullptr;
+
+    trading::OrderId order_id = engine_ptr->submit_order(
+        static_cast<trading::SymbolId>(symbol_id),
+        trading::to_ticks(price),
+        quantity,
+        side == 0, // 0 for Buy, 1 for Sell
+        static_cast<trading::OrderType>(order_type)
+    );
+    if (order_id == 0) return nullptr;
+    return cache_string(trading::order_id_to_string(order_id));
+}
+
+const char* submit_iceberg_order(trading::ExecutionEngine* engine_ptr, int symbol_id, double price, int quantity, int side, int display_quantity) {
+    if (!engine_ptr || symbol_id < 0 || display_quantity <= 0) return nullptr;
+
+    trading::OrderId order_id = engine_ptr->submit_iceberg_order(
+        static_cast<trading::SymbolId>(symbol_id),
+        trading::to_ticks(price),
+        quantity,
+        side == 0, // 0 for Buy, 1 for Sell
+        display_quantity
+    );
+    if (order_id == 0) return nullptr;
+    return cache_string(trading::order_id_to_string(order_id));
+}
+
+const char* submit_stop_order(trading::ExecutionEngine* engine_ptr, int symbol_id, double stop_price, double limit_price, int quantity, int side, int order_type) {
+    if (!engine_ptr || symbol_id < 0) return nullptr;
+    if (order_type < 0 || order_type > static_cast<int>(trading::OrderType::StopLimit)) return nullptr;
+
+    trading::OrderId order_id = engine_ptr->submit_stop_order(
+        static_cast<trading::SymbolId>(symbol_id),
+        trading::to_ticks(stop_price),
+        quantity,
+        side == 0, // 0 for Buy, 1 for Sell
+        static_cast<trading::OrderType>(order_type),
+        trading::to_ticks(limit_price)
+    );
+    if (order_id == 0) return nullptr;
+    return cache_string(trading::order_id_to_string(order_id));
+}
+
+const char* submit_account_order(trading::ExecutionEngine* engine_ptr, unsigned int account, int symbol_id, double price, int quantity, int side, int order_type) {
+    if (!engine_ptr || symbol_id < 0) return nullptr;
+    if (order_type < 0 || order_type > static_cast<int>(trading::OrderType::StopLimit)) return nullptr;
+
+    trading::OrderId order_id = engine_ptr->submit_order(
+        static_cast<trading::SymbolId>(symbol_id),
+        trading::to_ticks(price),
+        quantity,
+        side == 0, // 0 for Buy, 1 for Sell
+        static_cast<trading::OrderType>(order_type),
+        static_cast<trading::AccountId>(account)
+    );
+    if (order_id == 0) return nullptr;
+    return cache_string(trading::order_id_to_string(order_id));
+}
+
 bool cancel_order(trading::ExecutionEngine* engine_ptr, const char* order_id) {
-    // Not implemented yet
-    return false;
+    if (!engine_ptr || !order_id) return false;
+    return engine_ptr->cancel_order(order_id);
+}
+
+bool modify_order(trading::ExecutionEngine* engine_ptr, const char* order_id, double price, int quantity) {
+    if (!engine_ptr || !order_id) return false;
+    return engine_ptr->modify_order(order_id, price, quantity);
+}
+
+int cancel_all_orders(trading::ExecutionEngine* engine_ptr, const char* symbol) {
+    if (!engine_ptr || !symbol) return 0;
+    return static_cast<int>(engine_ptr->cancel_all_orders(symbol));
+}
+
+int get_symbol_count(trading::ExecutionEngine* engine_ptr) {
+    if (!engine_ptr) return 0;
+    return static_cast<int>(engine_ptr->symbol_count());
+}
+
+int get_positions_batch(trading::ExecutionEngine* engine_ptr, unsigned int account, const int* symbol_ids, int count, int* positions, double* average_prices, double* realized_pnls, double* unrealized_pnls) {
+    if (!engine_ptr || !symbol_ids || count <= 0) return 0;
+
+    batch_symbols.resize(static_cast<std::size_t>(count));
+    for (int i = 0; i < count; ++i) {
+        // Negative ids wrap to huge values and read as unknown
+        batch_symbols[i] = static_cast<trading::SymbolId>(symbol_ids[i]);
+    }
+    return fill_positions(engine_ptr, account, positions, average_prices, realized_pnls, unrealized_pnls);
+}
+
+int get_all_positions(trading::ExecutionEngine* engine_ptr, unsigned int account, int capacity, int* symbol_ids, int* positions, double* average_prices, double* realized_pnls, double* unrealized_pnls) {
+    if (!engine_ptr || capacity <= 0) return 0;
+
+    std::size_t count = std::min(engine_ptr->symbol_count(), static_cast<std::size_t>(capacity));
+    batch_symbols.resize(count);
+    for (std::size_t i = 0; i < count; ++i) {
+        batch_symbols[i] = static_cast<trading::SymbolId>(i);
+        if (symbol_ids) symbol_ids[i] = static_cast<int>(i);
+    }
+    return fill_positions(engine_ptr, account, positions, average_prices, realized_pnls, unrealized_pnls);
+}
+
+int get_top_of_book_batch(trading::ExecutionEngine* engine_ptr, const int* symbol_ids, int count, double* best_bids, double* best_asks, int* bid_quantities, int* ask_quantities, double* last_prices) {
+    if (!engine_ptr || !symbol_ids || count <= 0) return 0;
+
+    batch_symbols.resize(static_cast<std::size_t>(count));
+    for (int i = 0; i < count; ++i) {
+        batch_symbols[i] = static_cast<trading::SymbolId>(symbol_ids[i]);
+    }
+    batch_books.resize(batch_symbols.size());
+    engine_ptr->get_top_of_books(batch_symbols, batch_books);
+
+    for (int i = 0; i < count; ++i) {
+        const trading::TopOfBook& top = batch_books[i];
+        if (best_bids) best_bids[i] = trading::from_ticks(top.best_bid);
+        if (best_asks) best_asks[i] = trading::from_ticks(top.best_ask);
+        if (bid_quantities) bid_quantities[i] = top.bid_quantity;
+        if (ask_quantities) ask_quantities[i] = top.ask_quantity;
+        if (last_prices) last_prices[i] = trading::from_ticks(top.last_trade_price);
+    }
+    return count;
+}
+
+unsigned long long get_depth(trading::ExecutionEngine* engine_ptr, int symbol_id, int levels, double* bid_prices, int* bid_quantities, int* bid_count, double* ask_prices, int* ask_quantities, int* ask_count) {
+    if (bid_count) *bid_count = 0;
+    if (ask_count) *ask_count = 0;
+    if (!engine_ptr || symbol_id < 0 || levels <= 0) return 0;
+
+    engine_ptr->get_depth(static_cast<trading::SymbolId>(symbol_id), static_cast<std::size_t>(levels), depth_snapshot);
+    for (std::size_t i = 0; i < depth_snapshot.bids.size(); ++i) {
+        if (bid_prices) bid_prices[i] = trading::from_ticks(depth_snapshot.bids[i].price);
+        if (bid_quantities) bid_quantities[i] = depth_snapshot.bids[i].quantity;
+    }
+    for (std::size_t i = 0; i < depth_snapshot.asks.size(); ++i) {
+        if (ask_prices) ask_prices[i] = trading::from_ticks(depth_snapshot.asks[i].price);
+        if (ask_quantities) ask_quantities[i] = depth_snapshot.asks[i].quantity;
+    }
+    if (bid_count) *bid_count = static_cast<int>(depth_snapshot.bids.size());
+    if (ask_count) *ask_count = static_cast<int>(depth_snapshot.asks.size());
+    return depth_snapshot.sequence;
 }
 
 void subscribe_market_data(trading::ExecutionEngine* engine_ptr, const char* symbol, void (*callback)(const trading::MarketData*)) {
@@ -94,6 +271,47 @@ void unsubscribe_trades(trading::ExecutionEngine* engine_ptr, const char* symbol
     engine_ptr->unsubscribe_trades(symbol);
 }
 
+void subscribe_depth(trading::ExecutionEngine* engine_ptr, const char* symbol, void (*callback)(int, int, double, int, unsigned long long)) {
+    if (!engine_ptr || !symbol || !callback) return;
+
+    engine_ptr->subscribe_depth(symbol, [callback](const trading::DepthUpdate& update) {
+        callback(static_cast<int>(update.action), update.is_buy ? 0 : 1,
+                 trading::from_ticks(update.price), update.quantity, update.sequence);
+    });
+}
+
+void unsubscribe_depth(trading::ExecutionEngine* engine_ptr, const char* symbol) {
+    if (!engine_ptr || !symbol) return;
+    engine_ptr->unsubscribe_depth(symbol);
+}
+
+trading::L3Reader* open_l3_feed(trading::ExecutionEngine* engine_ptr, int symbol_id) {
+    if (!engine_ptr) return nullptr;
+    trading::SymbolId id = symbol_id < 0 ? trading::kInvalidSymbol : static_cast<trading::SymbolId>(symbol_id);
+    return new trading::L3Reader(engine_ptr->open_l3_feed(id));
+}
+
+int poll_l3_events(trading::L3Reader* reader, trading::L3Event* events, int capacity) {
+    if (!reader || !events) return 0;
+
+    int written = 0;
+    while (written < capacity) {
+        trading::L3Reader::Status status = reader->poll(events[written]);
+        if (status == trading::L3Reader::Status::Empty) break;
+        if (status == trading::L3Reader::Status::Ok) ++written;
+    }
+    return written;
+}
+
+unsigned long long get_l3_missed(trading::L3Reader* reader) {
+    if (!reader) return 0;
+    return reader->missed();
+}
+
+void close_l3_feed(trading::L3Reader* reader) {
+    delete reader;
+}
+
 int get_position(trading::ExecutionEngine* engine_ptr, const char* symbol) {
     if (!engine_ptr || !symbol) return 0;
     return engine_ptr->get_position(symbol);
@@ -114,4 +332,34 @@ double get_realized_pnl(trading::ExecutionEngine* engine_ptr, const char* symbol
     return engine_ptr->get_realized_pnl(symbol);
 }
 
+double get_best_bid(trading::ExecutionEngine* engine_ptr, const char* symbol) {
+    if (!engine_ptr || !symbol) return 0.0;
+    return engine_ptr->get_best_bid(symbol);
+}
+
+double get_best_ask(trading::ExecutionEngine* engine_ptr, const char* symbol) {
+    if (!engine_ptr || !symbol) return 0.0;
+    return engine_ptr->get_best_ask(symbol);
+}
+
+int get_account_position(trading::ExecutionEngine* engine_ptr, unsigned int account, const char* symbol) {
+    if (!engine_ptr || !symbol) return 0;
+    return engine_ptr->get_position(static_cast<trading::AccountId>(account), symbol);
+}
+
+double get_account_average_price(trading::ExecutionEngine* engine_ptr, unsigned int account, const char* symbol) {
+    if (!engine_ptr || !symbol) return 0.0;
+    return engine_ptr->get_average_price(static_cast<trading::AccountId>(account), symbol);
+}
+
+double get_account_unrealized_pnl(trading::ExecutionEngine* engine_ptr, unsigned int account, const char* symbol) {
+    if (!engine_ptr || !symbol) return 0.0;
+    return engine_ptr->get_unrealized_pnl(static_cast<trading::AccountId>(account), symbol);
+}
+
+double get_account_realized_pnl(trading::ExecutionEngine* engine_ptr, unsigned int account, const char* symbol) {
+    if (!engine_ptr || !symbol) return 0.0;
+    return engine_ptr->get_realized_pnl(static_cast<trading::AccountId>(account), symbol);
+}
+
 }
@@ -0,0 +1,65 @@
+#include "clock.hpp"
+#include <cstdio>
+#include <ctime>
+#include <thread>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define TRADING_HAS_TSC 1
+#endif
+
+namespace trading {
+
+namespace {
+
+#ifdef TRADING_HAS_TSC
+struct TscCalibration {
+    std::uint64_t tsc_base;
+    Timestamp ns_base;
+    double ns_per_tick;
+};
+
+TscCalibration calibrate_tsc() {
+    Timestamp start_ns = steady_clock_ns();
+    std::uint64_t start_tsc = __rdtsc();
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    Timestamp end_ns = steady_clock_ns();
+    std::uint64_t end_tsc = __rdtsc();
+
+    double ns_per_tick = end_tsc > start_tsc
+        ? static_cast<double>(end_ns - start_ns) / static_cast<double>(end_tsc - start_tsc)
+        : 0.0;
+    return TscCalibration{end_tsc, end_ns, ns_per_tick};
+}
+#endif
+
+} // anonymous namespace
+
+Timestamp tsc_clock_ns() {
+#ifdef TRADING_HAS_TSC
+    static const TscCalibration calibration = calibrate_tsc();
+    if (calibration.ns_per_tick > 0.0) {
+        // Signed, so a core whose counter reads just below the base gives a
+        // slightly earlier time rather than wrapping to the far future
+        auto elapsed = static_cast<double>(static_cast<std::int64_t>(__rdtsc() - calibration.tsc_base));
+        return calibration.ns_base + static_cast<Timestamp>(elapsed * calibration.ns_per_tick);
+    }
+#endif
+    return steady_clock_ns();
+}
+
+std::string format_timestamp(Timestamp wall_ns) {
+    constexpr Timestamp kNanosPerSecond = 1000000000;
+    std::time_t seconds = static_cast<std::time_t>(wall_ns / kNanosPerSecond);
+    long nanos = static_cast<long>(wall_ns % kNanosPerSecond);
+
+    std::tm local{};
+    localtime_r(&seconds, &local);
+
+    char buffer[40];
+    std::size_t length = std::strftime(buffer, sizeof(buffer), "%Y-%m-%d %H:%M:%S", &local);
+    std::snprintf(buffer + length, sizeof(buffer) - length, ".%09ld", nanos);
+    return buffer;
+}
+
+} // namespace trading
@@ -1,150 +1,929 @@
 #include "execution_engine.hpp"
+#include "journal.hpp"
+#include "ring_buffer.hpp"
+#include "snapshot.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <charconv>
 #include <chrono>
-#include <sstream>
-#include <iomanip>
 #include <thread>
 #include <random>
+#include <condition_variable>
+#include <system_error>
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
 
 namespace trading {
 
 namespace {
+
 class MarketDataGenerator {
 public:
+    using MonotonicClock = Timestamp (*)();
+
     MarketDataGenerator() : symbol_(""), price_(100.0), 
         gen_(std::random_device()()), dist_(-1.0, 1.0) {}
         
-    MarketDataGenerator(const std::string& symbol, double initial_price = 100.0)
-        : symbol_(symbol), price_(initial_price),
+    MarketDataGenerator(const std::string& symbol, double initial_price = 100.0,
+                        MonotonicClock monotonic_clock = steady_clock_ns)
+        : symbol_(symbol), price_(initial_price), monotonic_clock_(monotonic_clock),
           gen_(std::random_device()()), dist_(-1.0, 1.0) {}
 
     MarketData generate() {
         double change = dist_(gen_);
         price_ *= (1.0 + change * 0.01); // Max 1% price change
 
-        auto now = std::chrono::system_clock::now();
-        auto now_c = std::chrono::system_clock::to_time_t(now);
-        std::stringstream ss;
-        ss << std::put_time(std::localtime(&now_c), "%Y-%m-%d %H:%M:%S");
-
         return MarketData{
             symbol_,
             price_,
             100.0, // Fixed volume for simplicity
-            ss.str()
+            wall_clock_ns(),
+            monotonic_clock_()
         };
     }
 
 private:
     std::string symbol_;
     double price_;
+    MonotonicClock monotonic_clock_ = steady_clock_ns;
     std::mt19937 gen_;
     std::uniform_real_distribution<> dist_;
 };
 
-std::string generate_order_id() {
-    static std::random_device rd;
-    static std::mt19937 gen(rd());
-    static std::uniform_int_distribution<> dis(0, 15);
-    static const char* digits = "0123456789abcdef";
+} // anonymous namespace
 
-    std::string uuid;
-    uuid.reserve(36);
+std::string order_id_to_string(OrderId order_id) {
+    return std::to_string(order_id);
+}
 
-    for (int i = 0; i < 36; i++) {
-        if (i == 8 || i == 13 || i == 18 || i == 23) {
-            uuid += '-';
-        } else {
-            uuid += digits[dis(gen)];
+OrderId parse_order_id(const std::string& text) {
+    OrderId order_id = 0;
+    auto [end, ec] = std::from_chars(text.data(), text.data() + text.size(), order_id);
+    if (ec != std::errc() || end != text.data() + text.size()) {
+        return 0;
+    }
+    return order_id;
+}
+
+void OrderBook::PriceLevel::push_back(OrderNode* node) {
+    node->prev = tail;
+    node->next = nullptr;
+    node->level = this;
+    if (tail) {
+        tail->next = node;
+    } else {
+        head = node;
+    }
+    tail = node;
+    total_quantity += node->order.quantity;
+}
+
+void OrderBook::PriceLevel::unlink(OrderNode* node) {
+    if (node->prev) {
+        node->prev->next = node->next;
+    } else {
+        head = node->next;
+    }
+    if (node->next) {
+        node->next->prev = node->prev;
+    } else {
+        tail = node->prev;
+    }
+    total_quantity -= node->order.quantity;
+}
+
+OrderBook::OrderBook(const std::string& symbol, SymbolId symbol_id)
+    : symbol_(symbol),
+      symbol_id_(symbol_id),
+      bids_(&memory_),
+      asks_(&memory_),
+      order_index_(&memory_),
+      buy_stops_(&memory_),
+      sell_stops_(&memory_),
+      stop_index_(&memory_) {}
+
+bool OrderBook::add_order(const BookOrder& order, std::vector<Fill>* fills,
+                          std::vector<DepthUpdate>* depth, Timestamp time) {
+    std::lock_guard<std::mutex> lock(book_mutex);
+    command_time_ = time;
+    BookOrder incoming = order;
+    bool resting = is_stop_order(incoming.type) ? hold_stop(incoming, fills)
+                                                : match_and_rest(incoming, fills);
+    trigger_stops(fills);
+    finish_command(depth);
+    return resting;
+}
+
+bool OrderBook::match_and_rest(BookOrder& incoming, std::vector<Fill>* fills) {
+    switch (incoming.type) {
+        case OrderType::PostOnly: {
+            bool would_take = incoming.is_buy
+                ? !asks_.empty() && crosses(incoming, asks_.begin()->first)
+                : !bids_.empty() && crosses(incoming, bids_.begin()->first);
+            if (would_take) {
+                return false;
+            }
+            break;
+        }
+        case OrderType::FillOrKill: {
+            int available = incoming.is_buy ? available_quantity(incoming, asks_)
+                                            : available_quantity(incoming, bids_);
+            if (available < incoming.quantity) {
+                return false;
+            }
+            break;
         }
+        default:
+            break;
+    }
+
+    match_orders(incoming, fills);
+    bool rests = incoming.type == OrderType::Limit || incoming.type == OrderType::PostOnly;
+    if (incoming.quantity <= 0 || !rests) {
+        return false;
     }
-    return uuid;
+    if (incoming.is_buy) {
+        rest_order(incoming, bids_);
+    } else {
+        rest_order(incoming, asks_);
+    }
+    return true;
 }
 
-} // anonymous namespace
+bool OrderBook::cancel(OrderId order_id, std::vector<DepthUpdate>* depth, Timestamp time) {
+    std::lock_guard<std::mutex> lock(book_mutex);
+    command_time_ = time;
+    auto it = order_index_.find(order_id);
+    if (it == order_index_.end()) {
+        auto stop_it = stop_index_.find(order_id);
+        if (stop_it == stop_index_.end()) {
+            return false;
+        }
+        StopQueue& queue = stop_it->second->second.is_buy ? buy_stops_ : sell_stops_;
+        queue.erase(stop_it->second);
+        stop_index_.erase(stop_it);
+        return true;
+    }
+    OrderNode* node = it->second;
+    emit_l3(L3Event::Type::Cancel, node->order, node->order.price, node->order.quantity, 0);
+    order_index_.erase(it);
+    remove_order(node);
+    finish_command(depth);
+    return true;
+}
 
-void OrderBook::add_order(const Order& order) {
+bool OrderBook::modify(OrderId order_id, Price new_price, int new_quantity, std::vector<Fill>* fills,
+                       std::vector<DepthUpdate>* depth, Timestamp time) {
     std::lock_guard<std::mutex> lock(book_mutex);
-    if (order.is_buy) {
-        buy_orders.push(order);
+    command_time_ = time;
+    auto it = order_index_.find(order_id);
+    if (it == order_index_.end()) {
+        return false;
+    }
+    OrderNode* node = it->second;
+    BookOrder& resting = node->order;
+
+    // Quantities here are the full size, displayed plus hidden
+    if (new_quantity > 0 && new_price == resting.price &&
+        new_quantity <= resting.quantity + node->hidden_quantity) {
+        PriceLevel& level = *node->level;
+        touch_level(level, resting.is_buy);
+        int displayed = std::min(resting.quantity, new_quantity);
+        int hidden = new_quantity - displayed;
+        level.total_quantity -= resting.quantity - displayed;
+        level.hidden_quantity -= node->hidden_quantity - hidden;
+        int removed = resting.quantity - displayed;
+        resting.quantity = displayed;
+        node->hidden_quantity = hidden;
+        if (removed > 0) {
+            emit_l3(L3Event::Type::Cancel, resting, resting.price, removed, displayed);
+        }
+        finish_command(depth);
+        return true;
+    }
+
+    BookOrder replacement = resting;
+    replacement.price = new_price;
+    replacement.quantity = new_quantity;
+    if (new_quantity > 0) {
+        emit_l3(L3Event::Type::Replace, resting, new_price, new_quantity, 0);
     } else {
-        sell_orders.push(order);
+        emit_l3(L3Event::Type::Cancel, resting, resting.price, resting.quantity, 0);
     }
-    match_orders();
+    order_index_.erase(it);
+    remove_order(node);
+    if (new_quantity > 0) {
+        match_and_rest(replacement, fills);
+        trigger_stops(fills);
+    }
+    finish_command(depth);
+    return true;
 }
 
-void OrderBook::match_orders() {
-    while (!buy_orders.empty() && !sell_orders.empty()) {
-        auto& buy = buy_orders.top();
-        auto& sell = sell_orders.top();
-        
-        if (buy.price >= sell.price) {
-            int matched_quantity = std::min(buy.quantity, sell.quantity);
-            double matched_price = (buy.price + sell.price) / 2.0;
-            
-            // Update position and P&L
-            if (buy.quantity == matched_quantity) {
-                buy_orders.pop();
-            } else {
-                const_cast<Order&>(buy).quantity -= matched_quantity;
-            }
-            
-            if (sell.quantity == matched_quantity) {
-                sell_orders.pop();
-            } else {
-                const_cast<Order&>(sell).quantity -= matched_quantity;
-            }
-            
-            position_ += matched_quantity;
-            double old_value = average_price_ * position_;
-            double new_value = matched_price * matched_quantity;
-            average_price_ = (old_value + new_value) / (position_ + matched_quantity);
-            
-            // Calculate realized P&L
-            realized_pnl_ += (matched_price - average_price_) * matched_quantity;
+std::size_t OrderBook::cancel_all(std::vector<DepthUpdate>* depth, Timestamp time) {
+    std::lock_guard<std::mutex> lock(book_mutex);
+    command_time_ = time;
+    std::size_t cancelled = order_index_.size() + stop_index_.size();
+    // Every level goes, so there is nothing to diff
+    for (const auto& [price, level] : bids_) {
+        ++depth_sequence_;
+        if (depth) {
+            depth->push_back(DepthUpdate{DepthUpdate::Action::Delete, true, price, 0, depth_sequence_});
+        }
+    }
+    for (const auto& [price, level] : asks_) {
+        ++depth_sequence_;
+        if (depth) {
+            depth->push_back(DepthUpdate{DepthUpdate::Action::Delete, false, price, 0, depth_sequence_});
+        }
+    }
+    for (const auto& [order_id, node] : order_index_) {
+        emit_l3(L3Event::Type::Cancel, node->order, node->order.price, node->order.quantity, 0);
+        order_pool_.destroy(node);
+    }
+    order_index_.clear();
+    bids_.clear();
+    asks_.clear();
+    stop_index_.clear();
+    buy_stops_.clear();
+    sell_stops_.clear();
+    finish_command(depth);
+    return cancelled;
+}
+
+void OrderBook::remove_order(OrderNode* node) {
+    PriceLevel& level = *node->level;
+    touch_level(level, node->order.is_buy);
+    level.unlink(node);
+    level.hidden_quantity -= node->hidden_quantity;
+    bool is_buy = node->order.is_buy;
+    order_pool_.destroy(node);
+    if (level.empty()) {
+        if (is_buy) {
+            bids_.erase(level.price);
         } else {
+            asks_.erase(level.price);
+        }
+    }
+}
+
+bool OrderBook::crosses(const BookOrder& incoming, Price level_price) {
+    if (incoming.type == OrderType::Market) {
+        return true;
+    }
+    return incoming.is_buy ? incoming.price >= level_price
+                           : incoming.price <= level_price;
+}
+
+template <typename Ladder>
+int OrderBook::available_quantity(const BookOrder& incoming, const Ladder& opposite) const {
+    int available = 0;
+    for (const auto& [price, level] : opposite) {
+        if (available >= incoming.quantity || !crosses(incoming, price)) {
             break;
         }
+        available += level.total_quantity + level.hidden_quantity;
     }
+    return available;
 }
 
-double OrderBook::get_best_bid() const {
-    std::lock_guard<std::mutex> lock(book_mutex);
-    return buy_orders.empty() ? 0.0 : buy_orders.top().price;
+void OrderBook::replenish(OrderNode* node) {
+    // A refill is a new display slice, so it queues behind the level
+    PriceLevel& level = *node->level;
+    level.unlink(node);
+    int refill = std::min(node->order.display_quantity, node->hidden_quantity);
+    node->hidden_quantity -= refill;
+    level.hidden_quantity -= refill;
+    node->order.quantity = refill;
+    level.push_back(node);
+    emit_l3(L3Event::Type::Add, node->order, node->order.price, refill, refill);
 }
 
-double OrderBook::get_best_ask() const {
-    std::lock_guard<std::mutex> lock(book_mutex);
-    return sell_orders.empty() ? 0.0 : sell_orders.top().price;
+bool OrderBook::hold_stop(BookOrder& order, std::vector<Fill>* fills) {
+    if (stop_triggered(order)) {
+        return fire_stop(order, fills);
+    }
+    StopQueue& queue = order.is_buy ? buy_stops_ : sell_stops_;
+    Price key = order.is_buy ? order.stop_price : -order.stop_price;
+    stop_index_.emplace(order.order_id, queue.emplace(key, order));
+    return true;
+}
+
+bool OrderBook::stop_triggered(const BookOrder& order) const {
+    if (last_trade_price_ == 0) {
+        return false;
+    }
+    return order.is_buy ? last_trade_price_ >= order.stop_price
+                        : last_trade_price_ <= order.stop_price;
+}
+
+bool OrderBook::fire_stop(BookOrder& order, std::vector<Fill>* fills) {
+    order.type = order.type == OrderType::Stop ? OrderType::Market : OrderType::Limit;
+    return match_and_rest(order, fills);
+}
+
+void OrderBook::trigger_stops(std::vector<Fill>* fills) {
+    // Each fire may trade and move the last price, so re-check both sides
+    // until neither front stop is crossed
+    while (true) {
+        StopQueue* queue = nullptr;
+        if (!buy_stops_.empty() && stop_triggered(buy_stops_.begin()->second)) {
+            queue = &buy_stops_;
+        } else if (!sell_stops_.empty() && stop_triggered(sell_stops_.begin()->second)) {
+            queue = &sell_stops_;
+        } else {
+            return;
+        }
+
+        BookOrder order = queue->begin()->second;
+        stop_index_.erase(order.order_id);
+        queue->erase(queue->begin());
+        fire_stop(order, fills);
+    }
+}
+
+void OrderBook::match_orders(BookOrder& incoming, std::vector<Fill>* fills) {
+    if (incoming.is_buy) {
+        match_against(incoming, asks_, fills);
+    } else {
+        match_against(incoming, bids_, fills);
+    }
+}
+
+template <typename Ladder>
+void OrderBook::match_against(BookOrder& incoming, Ladder& opposite, std::vector<Fill>* fills) {
+    while (incoming.quantity > 0 && !opposite.empty()) {
+        auto level_it = opposite.begin();
+        PriceLevel& level = level_it->second;
+        if (!crosses(incoming, level.price)) {
+            break;
+        }
+        touch_level(level, !incoming.is_buy);
+
+        while (incoming.quantity > 0 && !level.empty()) {
+            OrderNode* node = level.head;
+            BookOrder& resting = node->order;
+            int matched_quantity = std::min(incoming.quantity, resting.quantity);
+
+            ++fill_sequence_;
+            if (fills) {
+                fills->push_back(Fill{incoming.order_id, resting.order_id, resting.price,
+                                      matched_quantity, incoming.is_buy, fill_sequence_, command_time(),
+                                      incoming.account, resting.account});
+            }
+
+            last_trade_price_ = resting.price;
+            incoming.quantity -= matched_quantity;
+            resting.quantity -= matched_quantity;
+            level.total_quantity -= matched_quantity;
+            emit_l3(L3Event::Type::Execute, resting, resting.price, matched_quantity,
+                    resting.quantity, incoming.order_id);
+            if (resting.quantity == 0) {
+                if (node->hidden_quantity > 0) {
+                    replenish(node);
+                } else {
+                    order_index_.erase(resting.order_id);
+                    level.unlink(node);
+                    order_pool_.destroy(node);
+                }
+            }
+        }
+
+        if (level.empty()) {
+            opposite.erase(level_it);
+        }
+    }
+}
+
+template <typename Ladder>
+void OrderBook::rest_order(const BookOrder& order, Ladder& ladder) {
+    auto [level_it, inserted] = ladder.try_emplace(order.price);
+    PriceLevel& level = level_it->second;
+    if (inserted) {
+        level.price = order.price;
+        touch_new_level(level, order.is_buy);
+    } else {
+        touch_level(level, order.is_buy);
+    }
+    int displayed = order.display_quantity > 0 ? std::min(order.quantity, order.display_quantity)
+                                               : order.quantity;
+    OrderNode* node = order_pool_.create(
+        OrderNode{order, nullptr, nullptr, nullptr, order.quantity - displayed});
+    node->order.quantity = displayed;
+    level.push_back(node);
+    emit_l3(L3Event::Type::Add, node->order, order.price, displayed, displayed);
+    level.hidden_quantity += node->hidden_quantity;
+    order_index_.emplace(order.order_id, node);
+}
+
+void OrderBook::touch_level(PriceLevel& level, bool is_buy) {
+    if (level.depth_epoch == depth_epoch_) {
+        return;
+    }
+    level.depth_epoch = depth_epoch_;
+    depth_touched_.push_back(DepthTouch{is_buy, level.price, true, level.total_quantity});
 }
 
-int OrderBook::get_position() const {
+void OrderBook::touch_new_level(PriceLevel& level, bool is_buy) {
+    level.depth_epoch = depth_epoch_;
+    // A level emptied earlier in this command and now refilled already has
+    // its original state recorded
+    for (const DepthTouch& touch : depth_touched_) {
+        if (touch.is_buy == is_buy && touch.price == level.price) {
+            return;
+        }
+    }
+    depth_touched_.push_back(DepthTouch{is_buy, level.price, false, 0});
+}
+
+void OrderBook::emit_depth(std::vector<DepthUpdate>* depth) {
+    for (const DepthTouch& touch : depth_touched_) {
+        const PriceLevel* level = nullptr;
+        if (touch.is_buy) {
+            auto it = bids_.find(touch.price);
+            level = it != bids_.end() ? &it->second : nullptr;
+        } else {
+            auto it = asks_.find(touch.price);
+            level = it != asks_.end() ? &it->second : nullptr;
+        }
+
+        DepthUpdate::Action action;
+        if (!level) {
+            if (!touch.existed) {
+                continue;
+            }
+            action = DepthUpdate::Action::Delete;
+        } else if (!touch.existed) {
+            action = DepthUpdate::Action::Add;
+        } else if (level->total_quantity != touch.quantity) {
+            action = DepthUpdate::Action::Change;
+        } else {
+            continue;
+        }
+
+        ++depth_sequence_;
+        if (depth) {
+            depth->push_back(DepthUpdate{action, touch.is_buy, touch.price,
+                                         level ? level->total_quantity : 0, depth_sequence_});
+        }
+    }
+    depth_touched_.clear();
+    ++depth_epoch_;
+}
+
+void OrderBook::get_depth(std::size_t levels, DepthSnapshot& out) const {
+    out.bids.clear();
+    out.asks.clear();
     std::lock_guard<std::mutex> lock(book_mutex);
-    return position_;
+    for (const auto& [price, level] : bids_) {
+        if (out.bids.size() == levels) {
+            break;
+        }
+        out.bids.push_back(DepthLevel{price, level.total_quantity});
+    }
+    for (const auto& [price, level] : asks_) {
+        if (out.asks.size() == levels) {
+            break;
+        }
+        out.asks.push_back(DepthLevel{price, level.total_quantity});
+    }
+    out.sequence = depth_sequence_;
 }
 
-double OrderBook::get_average_price() const {
+std::shared_ptr<const BroadcastRing<L3Event>> OrderBook::open_l3_feed(std::size_t capacity) {
     std::lock_guard<std::mutex> lock(book_mutex);
-    return average_price_;
+    if (!l3_ring_) {
+        l3_ring_ = std::make_shared<BroadcastRing<L3Event>>(capacity);
+    }
+    return l3_ring_;
 }
 
-double OrderBook::get_unrealized_pnl() const {
+void OrderBook::save(BookState& out) const {
     std::lock_guard<std::mutex> lock(book_mutex);
-    double mid_price = (get_best_bid() + get_best_ask()) / 2.0;
-    return position_ * (mid_price - average_price_);
+    out.orders.clear();
+    out.stops.clear();
+    auto save_ladder = [&out](const auto& ladder) {
+        for (const auto& [price, level] : ladder) {
+            for (const OrderNode* node = level.head; node != nullptr; node = node->next) {
+                out.orders.push_back(BookState::Resting{node->order, node->hidden_quantity});
+            }
+        }
+    };
+    save_ladder(bids_);
+    save_ladder(asks_);
+    for (const StopQueue* queue : {&buy_stops_, &sell_stops_}) {
+        for (const auto& [key, order] : *queue) {
+            out.stops.push_back(order);
+        }
+    }
+    out.last_trade_price = last_trade_price_;
+    out.fill_sequence = fill_sequence_;
+    out.depth_sequence = depth_sequence_;
+    out.l3_sequence = l3_sequence_;
 }
 
-double OrderBook::get_realized_pnl() const {
+void OrderBook::restore(const BookState& state) {
     std::lock_guard<std::mutex> lock(book_mutex);
-    return realized_pnl_;
+    for (const auto& [order_id, node] : order_index_) {
+        order_pool_.destroy(node);
+    }
+    order_index_.clear();
+    bids_.clear();
+    asks_.clear();
+    stop_index_.clear();
+    buy_stops_.clear();
+    sell_stops_.clear();
+
+    for (const BookState::Resting& resting : state.orders) {
+        auto link = [&](auto& ladder) {
+            PriceLevel& level = ladder.try_emplace(resting.order.price).first->second;
+            level.price = resting.order.price;
+            OrderNode* node = order_pool_.create(
+                OrderNode{resting.order, nullptr, nullptr, nullptr, resting.hidden_quantity});
+            level.push_back(node);
+            level.hidden_quantity += node->hidden_quantity;
+            order_index_.emplace(node->order.order_id, node);
+        };
+        if (resting.order.is_buy) {
+            link(bids_);
+        } else {
+            link(asks_);
+        }
+    }
+    for (const BookOrder& order : state.stops) {
+        StopQueue& queue = order.is_buy ? buy_stops_ : sell_stops_;
+        Price key = order.is_buy ? order.stop_price : -order.stop_price;
+        stop_index_.emplace(order.order_id, queue.emplace(key, order));
+    }
+
+    last_trade_price_ = state.last_trade_price;
+    fill_sequence_ = state.fill_sequence;
+    depth_sequence_ = state.depth_sequence;
+    l3_sequence_ = state.l3_sequence;
+    publish_top_of_book();
+}
+
+void OrderBook::emit_l3(L3Event::Type type, const BookOrder& order, Price price, int quantity,
+                        int remaining_quantity, OrderId other_order_id) {
+    // Numbered from the book's history whether or not a feed is open, so
+    // the sequence survives recovery and is the same in every engine
+    ++l3_sequence_;
+    if (!l3_ring_) {
+        return;
+    }
+    l3_ring_->push(L3Event{l3_sequence_, command_time(), order.order_id, other_order_id, price, quantity,
+                           remaining_quantity, symbol_id_, type, order.is_buy});
+}
+
+void OrderBook::finish_command(std::vector<DepthUpdate>* depth) {
+    emit_depth(depth);
+    publish_top_of_book();
+}
+
+Timestamp OrderBook::command_time() {
+    // A command's fills and events all share one clock read
+    if (command_time_ == 0) {
+        command_time_ = wall_clock_ns();
+    }
+    return command_time_;
+}
+
+void OrderBook::publish_top_of_book() {
+    TopOfBook top;
+    if (!bids_.empty()) {
+        top.best_bid = bids_.begin()->first;
+        top.bid_quantity = bids_.begin()->second.total_quantity;
+    }
+    if (!asks_.empty()) {
+        top.best_ask = asks_.begin()->first;
+        top.ask_quantity = asks_.begin()->second.total_quantity;
+    }
+    top.last_trade_price = last_trade_price_;
+
+    // Most commands leave the top untouched; skipping those stores keeps
+    // the snapshot's cache line quiet for pollers
+    if (top != published_top_) {
+        published_top_ = top;
+        top_of_book_.store(top);
+    }
+}
+
+double OrderBook::get_best_bid() const {
+    return from_ticks(get_top_of_book().best_bid);
+}
+
+double OrderBook::get_best_ask() const {
+    return from_ticks(get_top_of_book().best_ask);
+}
+
+double OrderBook::get_last_trade_price() const {
+    return from_ticks(get_top_of_book().last_trade_price);
+}
+
+SymbolId SymbolRegistry::intern(const std::string& symbol) {
+    SymbolId id = find(symbol);
+    if (id != kInvalidSymbol) {
+        return id;
+    }
+    id = static_cast<SymbolId>(names_.size());
+    const Name* name = names_.emplace_back(Name{symbol, id});
+    if (name == nullptr) {
+        return kInvalidSymbol;
+    }
+    index_.insert(std::hash<std::string_view>{}(name->text), name);
+    return id;
+}
+
+SymbolId SymbolRegistry::find(std::string_view symbol) const {
+    const Name* name = index_.find(std::hash<std::string_view>{}(symbol),
+                                   [symbol](const Name& candidate) { return candidate.text == symbol; });
+    return name != nullptr ? name->id : kInvalidSymbol;
+}
+
+void Position::apply(bool is_buy, double price, int fill_quantity) {
+    bool long_position = quantity > 0;
+    int signed_quantity = is_buy ? fill_quantity : -fill_quantity;
+
+    if (quantity == 0 || long_position == is_buy) {
+        // Opening or adding: blend the fill into the average cost
+        double open_cost = average_price * std::abs(quantity) + price * fill_quantity;
+        quantity += signed_quantity;
+        average_price = open_cost / std::abs(quantity);
+        return;
+    }
+
+    // Reducing: the closed part realizes against the average cost
+    int closed = std::min(fill_quantity, std::abs(quantity));
+    realized_pnl += (long_position ? price - average_price : average_price - price) * closed;
+    quantity += signed_quantity;
+    if (quantity == 0) {
+        average_price = 0.0;
+    } else if ((quantity > 0) != long_position) {
+        // Flipped through flat; the remainder opened at this fill's price
+        average_price = price;
+    }
+}
+
+void PositionKeeper::apply(SymbolId symbol, const Fill& fill) {
+    double price = from_ticks(fill.price);
+
+    Slot& aggressor = slot(fill.aggressor_account, symbol);
+    aggressor.working.apply(fill.aggressor_is_buy, price, fill.quantity);
+    aggressor.published.store(aggressor.working);
+
+    Slot& passive = slot(fill.passive_account, symbol);
+    passive.working.apply(!fill.aggressor_is_buy, price, fill.quantity);
+    passive.published.store(passive.working);
+}
+
+Position PositionKeeper::get(AccountId account, SymbolId symbol) const {
+    const Slot* found = find(key(account, symbol));
+    return found != nullptr ? found->published.load() : Position{};
+}
+
+void PositionKeeper::get(AccountId account, std::span<const SymbolId> symbols,
+                         std::span<Position> out) const {
+    for (std::size_t i = 0; i < symbols.size(); ++i) {
+        out[i] = get(account, symbols[i]);
+    }
+}
+
+void PositionKeeper::save(std::vector<Entry>& out) const {
+    out.clear();
+    out.reserve(slots_.size());
+    for (const Slot& slot : slots_) {
+        out.push_back(Entry{static_cast<AccountId>(slot.key >> 32), static_cast<SymbolId>(slot.key), slot.working});
+    }
+}
+
+void PositionKeeper::restore(const std::vector<Entry>& entries) {
+    for (const Entry& entry : entries) {
+        Slot& restored = slot(entry.account, entry.symbol);
+        restored.working = entry.position;
+        restored.published.store(entry.position);
+    }
+}
+
+PositionKeeper::Slot& PositionKeeper::slot(AccountId account, SymbolId symbol) {
+    // The writer is the only thread that adds slots, so its lookups race
+    // nothing and the slot is fully built before the index publishes it
+    std::uint64_t slot_key = key(account, symbol);
+    if (Slot* found = find(slot_key)) {
+        return *found;
+    }
+    Slot& added = slots_.emplace_back(slot_key);
+    index_.insert(slot_key, &added);
+    return added;
 }
 
-ExecutionEngine::ExecutionEngine() = default;
+// Where a matching thread hands a command's outcome back to the caller
+// blocked in execute(). It lives on the caller's stack, so completing one
+// allocates nothing, unlike a std::promise's shared state.
+struct CommandResult {
+    std::mutex mutex;
+    std::condition_variable done;
+    bool ready = false;
+    std::size_t value = 0;
+
+    void set(std::size_t result) {
+        // Notified under the lock, so the caller cannot return and destroy
+        // this before the notify is over
+        std::lock_guard<std::mutex> lock(mutex);
+        value = result;
+        ready = true;
+        done.notify_one();
+    }
+
+    std::size_t get() {
+        std::unique_lock<std::mutex> lock(mutex);
+        done.wait(lock, [this] { return ready; });
+        return value;
+    }
+};
+
+struct ExecutionEngine::MatchingCommand {
+    enum class Type { Submit, Cancel, Modify, CancelAll };
+
+    Type type;
+    SymbolId symbol;
+    // Submit: the full order. Cancel: only order_id is used. Modify:
+    // order_id plus the new price and quantity.
+    BookOrder order;
+    // 0 for live commands; replay passes the journaled time
+    Timestamp timestamp = 0;
+    // Set by callers that block for the outcome
+    CommandResult* result = nullptr;
+    // Set by callers that then wait for the command to be durable; receives
+    // its journal sequence before result is set
+    std::uint64_t* journal_sequence = nullptr;
+};
+
+// One matching thread and the ring of commands for the symbols it owns
+struct MatchingShard {
+    explicit MatchingShard(std::size_t queue_capacity) : queue(queue_capacity) {}
+
+    std::thread thread;
+    MpscRingBuffer<ExecutionEngine::MatchingCommand> queue;
+    std::atomic<bool> stopping{false};
+};
+
+// One market data dispatcher thread and the ticks queued for its symbols
+struct DispatchShard {
+    explicit DispatchShard(std::size_t queue_capacity) : queue(queue_capacity) {}
+
+    std::thread thread;
+    MpscRingBuffer<ExecutionEngine::MarketDataEvent> queue;
+    std::atomic<bool> stopping{false};
+};
+
+// The thread that books fills into positions, fed by every matching thread
+struct AccountingShard {
+    explicit AccountingShard(std::size_t queue_capacity) : queue(queue_capacity) {}
+
+    std::thread thread;
+    MpscRingBuffer<ExecutionEngine::FillEvent> queue;
+    std::atomic<bool> stopping{false};
+};
+
+namespace {
+
+// Spin briefly when idle, then yield, then nap, so an idle worker does not
+// burn a core but a busy one never sleeps between items
+class IdleBackoff {
+public:
+    void reset() { rounds_ = 0; }
+
+    void pause() {
+        constexpr int kSpinRounds = 256;
+        constexpr int kYieldRounds = 4096;
+        if (++rounds_ < kSpinRounds) {
+            return;
+        }
+        if (rounds_ < kYieldRounds) {
+            std::this_thread::yield();
+        } else {
+            std::this_thread::sleep_for(std::chrono::microseconds(50));
+        }
+    }
+
+private:
+    int rounds_ = 0;
+};
+
+void pin_thread_to_core(std::thread& thread, int core) {
+#ifdef __linux__
+    cpu_set_t cpus;
+    CPU_ZERO(&cpus);
+    CPU_SET(core, &cpus);
+    pthread_setaffinity_np(thread.native_handle(), sizeof(cpus), &cpus);
+#else
+    // Affinity is advisory; other platforms just run unpinned
+    (void)thread;
+    (void)core;
+#endif
+}
+
+} // anonymous namespace
+
+ExecutionEngine::ExecutionEngine() : ExecutionEngine(EngineConfig{}) {}
+
+ExecutionEngine::ExecutionEngine(const EngineConfig& config)
+    : config(config),
+      symbols(std::min(config.max_symbols, kMaxSymbols)),
+      order_books(std::min(config.max_symbols, kMaxSymbols)),
+      market_data_callbacks(std::min(config.max_symbols, kMaxSymbols)),
+      market_data_rates(std::min(config.max_symbols, kMaxSymbols)),
+      trade_callbacks(std::min(config.max_symbols, kMaxSymbols)),
+      depth_callbacks(std::min(config.max_symbols, kMaxSymbols)),
+      journal_sequencers(std::min(config.max_symbols, kMaxSymbols)) {
+    // Recovered and opened before any thread starts, so replay has the
+    // books to itself and a failure can simply throw
+    if (!config.journal_directory.empty()) {
+        recover_from_journal();
+        Journal::Tap tap;
+        if (config.snapshots) {
+            // The replica starts from the recovered state and follows the
+            // journal from there. Its ring is deeper than the journal's so
+            // a snapshot copy rarely backs records up into the journal.
+            SnapshotImage image;
+            save_state(image);
+            snapshotter = std::make_unique<Snapshotter>(config.journal_directory, image, 4 * config.queue_capacity,
+                                                        config.snapshot_interval_seconds);
+            tap = [replica = snapshotter.get()](const JournalRecord& record, const std::string* name) {
+                replica->feed(record, name);
+            };
+        }
+        journal = std::make_unique<Journal>(config.journal_directory, config.journal_segment_bytes,
+                                            config.queue_capacity, recovery.last_sequence + 1, std::move(tap));
+    }
+
+    // Matching threads run for the engine's whole lifetime so orders are
+    // processed whether or not the market data simulator is started
+    for (std::size_t i = 0; i < config.matching_threads; ++i) {
+        shards.push_back(std::make_unique<MatchingShard>(config.queue_capacity));
+    }
+    for (std::size_t i = 0; i < shards.size(); ++i) {
+        MatchingShard& shard = *shards[i];
+        shard.thread = std::thread(&ExecutionEngine::matching_thread_func, this, std::ref(shard));
+        if (!config.matching_cores.empty()) {
+            pin_thread_to_core(shard.thread, config.matching_cores[i % config.matching_cores.size()]);
+        }
+    }
+
+    for (std::size_t i = 0; i < config.dispatch_threads; ++i) {
+        dispatchers.push_back(std::make_unique<DispatchShard>(config.queue_capacity));
+    }
+    for (auto& dispatcher : dispatchers) {
+        dispatcher->thread = std::thread(&ExecutionEngine::dispatch_thread_func, this, std::ref(*dispatcher));
+    }
+
+    accounting = std::make_unique<AccountingShard>(config.queue_capacity);
+    accounting->thread = std::thread(&ExecutionEngine::accounting_thread_func, this, std::ref(*accounting));
+}
 
 ExecutionEngine::~ExecutionEngine() {
     stop();
+    for (auto& shard : shards) {
+        shard->stopping.store(true, std::memory_order_release);
+        if (shard->thread.joinable()) {
+            shard->thread.join();
+        }
+    }
+    for (auto& dispatcher : dispatchers) {
+        dispatcher->stopping.store(true, std::memory_order_release);
+        if (dispatcher->thread.joinable()) {
+            dispatcher->thread.join();
+        }
+    }
+    // After the matching threads, so every command they applied is on disk
+    journal.reset();
+    // After the journal, which feeds it
+    snapshotter.reset();
+    // After the matching threads, so every fill they queued is booked
+    accounting->stopping.store(true, std::memory_order_release);
+    if (accounting->thread.joinable()) {
+        accounting->thread.join();
+    }
 }
 
 void ExecutionEngine::start() {
+    // A source that ran to the end leaves its thread finished but still
+    // joinable, and a live one is stopped first
+    running = false;
+    if (market_data_thread.joinable()) {
+        market_data_thread.join();
+    }
+    std::shared_ptr<MarketDataSource> source;
+    {
+        std::lock_guard<std::mutex> lock(engine_mutex);
+        source = market_data_source;
+    }
+    if (source) {
+        source->reset();
+    }
     running = true;
     market_data_thread = std::thread(&ExecutionEngine::market_data_thread_func, this);
 }
@@ -155,83 +934,806 @@ void ExecutionEngine::stop() {
     }
 }
 
+void ExecutionEngine::set_market_data_source(std::shared_ptr<MarketDataSource> source) {
+    std::lock_guard<std::mutex> lock(engine_mutex);
+    market_data_source = std::move(source);
+}
+
 void ExecutionEngine::market_data_thread_func() {
-    std::unordered_map<std::string, MarketDataGenerator> generators;
+    std::shared_ptr<MarketDataSource> source;
+    {
+        std::lock_guard<std::mutex> lock(engine_mutex);
+        source = market_data_source;
+    }
+    if (source) {
+        source->run(*this);
+        return;
+    }
+
+    using Clock = std::chrono::steady_clock;
+    // Caps catch-up per symbol per pass so one fast symbol cannot starve the rest
+    constexpr int kMaxTicksPerPass = 1024;
+    // Longest idle wait, which bounds how long a new subscription waits
+    constexpr auto kMaxIdle = std::chrono::milliseconds(10);
+
+    struct SymbolSchedule {
+        MarketDataGenerator generator;
+        Clock::time_point next_tick;
+        bool active = false;
+    };
+    std::vector<SymbolSchedule> schedules;
     
+    // Never takes engine_mutex: symbols and subscriber lists are read
+    // through their lock-free published views
     while (running) {
-        {
-            std::lock_guard<std::mutex> lock(engine_mutex);
-            for (const auto& [symbol, callbacks] : market_data_callbacks) {
-                if (generators.find(symbol) == generators.end()) {
-                    generators.emplace(symbol, MarketDataGenerator(symbol));
-                }
-                auto data = generators[symbol].generate();
-                for (const auto& callback : callbacks) {
-                    callback(data);
+        auto now = Clock::now();
+        auto next_wake = now + kMaxIdle;
+
+        std::size_t symbol_count = order_books.size();
+        while (schedules.size() < symbol_count) {
+            schedules.push_back(SymbolSchedule{
+                MarketDataGenerator(order_books[schedules.size()].symbol(), 100.0,
+                                    config.tsc_clock ? tsc_clock_ns : steady_clock_ns),
+                now});
+        }
+
+        for (std::size_t id = 0; id < symbol_count; ++id) {
+            SymbolSchedule& schedule = schedules[id];
+            auto subscribers = market_data_callbacks[id].snapshot();
+            double rate = market_data_rates[id].load(std::memory_order_relaxed);
+            if (!subscribers || subscribers->empty() || rate <= 0.0) {
+                schedule.active = false;
+                continue;
+            }
+            if (!schedule.active) {
+                schedule.active = true;
+                schedule.next_tick = now;
+            }
+
+            // Deadlines advance by whole periods from the previous deadline,
+            // so time spent in callbacks never stretches the interval
+            auto period = std::max(
+                std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(1.0 / rate)),
+                Clock::duration(1));
+            for (int ticks = 0; ticks < kMaxTicksPerPass && schedule.next_tick <= now; ++ticks) {
+                publish_market_data(MarketDataEvent{static_cast<SymbolId>(id), schedule.generator.generate()});
+                schedule.next_tick += period;
+            }
+            next_wake = std::min(next_wake, schedule.next_tick);
+        }
+
+        if (config.market_data_busy_spin) {
+            while (running && Clock::now() < next_wake) {
+            }
+        } else {
+            std::this_thread::sleep_until(next_wake);
+        }
+    }
+}
+
+void ExecutionEngine::publish_market_data(const MarketDataEvent& event) {
+    if (dispatchers.empty()) {
+        deliver_market_data(event);
+        return;
+    }
+
+    // A symbol always maps to the same dispatcher, so its ticks stay in order
+    DispatchShard& dispatcher = *dispatchers[event.symbol % dispatchers.size()];
+    while (!dispatcher.queue.try_push(event)) {
+        if (!running) {
+            return;
+        }
+        std::this_thread::yield();
+    }
+}
+
+void ExecutionEngine::publish_market_data(std::span<const SymbolId> symbols, std::span<MarketData> ticks) {
+    Timestamp now = config.tsc_clock ? tsc_clock_ns() : steady_clock_ns();
+    for (MarketData& tick : ticks) {
+        tick.monotonic_timestamp = now;
+    }
+    if (!dispatchers.empty()) {
+        for (std::size_t i = 0; i < ticks.size(); ++i) {
+            if (symbols[i] < order_books.size()) {
+                publish_market_data(MarketDataEvent{symbols[i], ticks[i]});
+            }
+        }
+        return;
+    }
+
+    // The few symbols a batch usually spans are resolved once each. A
+    // batch spread over many symbols just starts the list over, so the
+    // search stays short.
+    constexpr std::size_t kMaxResolved = 16;
+    std::pair<SymbolId, SubscriberList<MarketDataCallback>::Snapshot> resolved[kMaxResolved];
+    std::size_t resolved_count = 0;
+    std::size_t last = 0;
+    for (std::size_t i = 0; i < ticks.size(); ++i) {
+        if (symbols[i] >= order_books.size()) {
+            continue;
+        }
+        if (resolved_count == 0 || resolved[last].first != symbols[i]) {
+            last = 0;
+            while (last < resolved_count && resolved[last].first != symbols[i]) {
+                ++last;
+            }
+            if (last == resolved_count) {
+                if (resolved_count == kMaxResolved) {
+                    resolved_count = 0;
+                    last = 0;
                 }
+                resolved[last] = {symbols[i], market_data_callbacks[symbols[i]].snapshot()};
+                ++resolved_count;
+            }
+        }
+        if (const auto& subscribers = resolved[last].second) {
+            for (const auto& callback : *subscribers) {
+                callback(ticks[i]);
             }
         }
-        std::this_thread::sleep_for(std::chrono::milliseconds(100));
     }
 }
 
-std::string ExecutionEngine::submit_order(const Order& order) {
+void ExecutionEngine::deliver_market_data(const MarketDataEvent& event) {
+    // Subscribers are resolved at delivery time, so an unsubscribe takes
+    // effect for ticks that were still queued
+    auto subscribers = market_data_callbacks[event.symbol].snapshot();
+    if (!subscribers) {
+        return;
+    }
+    for (const auto& callback : *subscribers) {
+        callback(event.data);
+    }
+}
+
+void ExecutionEngine::dispatch_thread_func(DispatchShard& dispatcher) {
+    IdleBackoff backoff;
+    MarketDataEvent event;
+
+    while (true) {
+        if (dispatcher.queue.try_pop(event)) {
+            backoff.reset();
+            deliver_market_data(event);
+            continue;
+        }
+        if (dispatcher.stopping.load(std::memory_order_acquire)) {
+            return;
+        }
+        backoff.pause();
+    }
+}
+
+void ExecutionEngine::matching_thread_func(MatchingShard& shard) {
+    IdleBackoff backoff;
+    MatchingCommand command;
+
+    while (true) {
+        if (shard.queue.try_pop(command)) {
+            backoff.reset();
+            // This thread is the only writer for its symbols' books
+            std::size_t result = apply_command(command);
+            if (command.result) {
+                command.result->set(result);
+            }
+            continue;
+        }
+        if (shard.stopping.load(std::memory_order_acquire)) {
+            return;
+        }
+        backoff.pause();
+    }
+}
+
+void ExecutionEngine::accounting_thread_func(AccountingShard& accounting) {
+    IdleBackoff backoff;
+    FillEvent event;
+
+    while (true) {
+        if (accounting.queue.try_pop(event)) {
+            backoff.reset();
+            positions.apply(event.symbol, event.fill);
+            continue;
+        }
+        if (accounting.stopping.load(std::memory_order_acquire)) {
+            return;
+        }
+        backoff.pause();
+    }
+}
+
+std::size_t ExecutionEngine::execute(MatchingCommand command) {
+    std::uint64_t journal_sequence = 0;
+    if (journal && config.journal_sync) {
+        command.journal_sequence = &journal_sequence;
+    }
+
+    std::size_t result = 0;
+    if (shards.empty()) {
+        result = apply_command(command);
+    } else {
+        CommandResult outcome;
+        command.result = &outcome;
+        MatchingShard& shard = *shards[command.symbol % shards.size()];
+        while (!shard.queue.try_push(command)) {
+            std::this_thread::yield();
+        }
+        result = outcome.get();
+    }
+
+    // Only the caller waits for the disk; the matching thread has moved on
+    if (journal_sequence != 0) {
+        journal->wait_durable(journal_sequence);
+    }
+    return result;
+}
+
+bool ExecutionEngine::post(const MatchingCommand& command) {
+    if (shards.empty()) {
+        apply_command(command);
+        return true;
+    }
+    return shards[command.symbol % shards.size()]->queue.try_push(command);
+}
+
+std::size_t ExecutionEngine::apply_command(const MatchingCommand& command) {
+    OrderBook& book = order_books[command.symbol];
+    // Reused per thread so steady-state matching does not allocate
+    thread_local std::vector<Fill> fills;
+    thread_local std::vector<DepthUpdate> depth;
+    fills.clear();
+    depth.clear();
+
+    // Matching threads are the only writers for their symbols, so their
+    // journal order is book order; inline callers need the sequencer
+    // A journaled command is applied at the time it is journaled with, so
+    // replaying it reproduces the same fill and event timestamps
+    Timestamp time = command.timestamp;
+    std::unique_lock<std::mutex> sequencer;
+    if (journal) {
+        if (shards.empty()) {
+            sequencer = std::unique_lock<std::mutex>(journal_sequencers[command.symbol]);
+        }
+        if (time == 0) {
+            time = wall_clock_ns();
+        }
+        journal_command(command, time);
+    }
+
+    std::size_t result = 0;
+    switch (command.type) {
+        case MatchingCommand::Type::Submit:
+            result = book.add_order(command.order, &fills, &depth, time) ? 1 : 0;
+            break;
+        case MatchingCommand::Type::Cancel:
+            result = book.cancel(command.order.order_id, &depth, time) ? 1 : 0;
+            break;
+        case MatchingCommand::Type::Modify:
+            result = book.modify(command.order.order_id, command.order.price,
+                                 command.order.quantity, &fills, &depth, time) ? 1 : 0;
+            break;
+        case MatchingCommand::Type::CancelAll:
+            result = book.cancel_all(&depth, time);
+            break;
+    }
+    if (sequencer.owns_lock()) {
+        sequencer.unlock();
+    }
+
+    record_fills(command.symbol, fills);
+    publish_fills(command.symbol, fills);
+    publish_depth(command.symbol, depth);
+    return result;
+}
+
+void ExecutionEngine::journal_command(const MatchingCommand& command, Timestamp time) {
+    JournalRecord record{};
+    record.timestamp = time;
+    record.order_id = command.order.order_id;
+    record.price = command.order.price;
+    record.stop_price = command.order.stop_price;
+    record.quantity = command.order.quantity;
+    record.display_quantity = command.order.display_quantity;
+    record.account = command.order.account;
+    record.symbol = command.symbol;
+    record.order_type = command.order.type;
+    record.is_buy = command.order.is_buy;
+    switch (command.type) {
+        case MatchingCommand::Type::Submit: record.type = JournalRecord::Type::Submit; break;
+        case MatchingCommand::Type::Cancel: record.type = JournalRecord::Type::Cancel; break;
+        case MatchingCommand::Type::Modify: record.type = JournalRecord::Type::Modify; break;
+        case MatchingCommand::Type::CancelAll: record.type = JournalRecord::Type::CancelAll; break;
+    }
+
+    std::uint64_t sequence = journal->append(record);
+    if (command.journal_sequence) {
+        *command.journal_sequence = sequence;
+    }
+}
+
+void ExecutionEngine::publish_fills(SymbolId symbol, const std::vector<Fill>& fills) {
+    if (fills.empty()) {
+        return;
+    }
+    auto subscribers = trade_callbacks[symbol].snapshot();
+    if (!subscribers || subscribers->empty()) {
+        return;
+    }
+
+    // The book lock is already released; callbacks only see immutable copies
+    const std::string& symbol_name = order_books[symbol].symbol();
+    for (const Fill& fill : fills) {
+        Trade trade{
+            order_id_to_string(fill.aggressor_order_id),
+            symbol_name,
+            from_ticks(fill.price),
+            fill.quantity,
+            fill.timestamp,
+            order_id_to_string(fill.passive_order_id),
+            fill.aggressor_is_buy,
+            fill.sequence
+        };
+        for (const auto& callback : *subscribers) {
+            callback(trade);
+        }
+    }
+}
+
+void ExecutionEngine::publish_depth(SymbolId symbol, const std::vector<DepthUpdate>& depth) {
+    if (depth.empty()) {
+        return;
+    }
+    auto subscribers = depth_callbacks[symbol].snapshot();
+    if (!subscribers || subscribers->empty()) {
+        return;
+    }
+    for (const DepthUpdate& update : depth) {
+        for (const auto& callback : *subscribers) {
+            callback(update);
+        }
+    }
+}
+
+void ExecutionEngine::record_fills(SymbolId symbol, const std::vector<Fill>& fills) {
+    for (const Fill& fill : fills) {
+        // Fills are never dropped; a full ring holds matching back until
+        // the accounting thread catches up
+        while (!accounting->queue.try_push(FillEvent{symbol, fill})) {
+            std::this_thread::yield();
+        }
+    }
+}
+
+void ExecutionEngine::recover_from_journal() {
+    JournalReader reader(config.journal_directory);
+    SnapshotImage image;
+    if (config.snapshots && load_latest_snapshot(config.journal_directory, image)) {
+        restore_state(image);
+        recovery.snapshot_sequence = image.sequence;
+        recovery.last_sequence = image.sequence;
+        reader.skip_to(image.sequence);
+    }
+
+    JournalRecord record;
+    std::string_view name;
+    std::vector<Fill> fills;
+    std::uint64_t last_order_sequence = next_order_sequence.load(std::memory_order_relaxed) - 1;
+
+    while (reader.next(record, name)) {
+        if (record.sequence <= recovery.last_sequence) {
+            continue;  // Already in the snapshot
+        }
+        if (recovery.last_sequence == 0 && record.sequence != 1) {
+            // Snapshots pruned the start of the journal, and none was loaded
+            throw std::system_error(EINVAL, std::generic_category(),
+                                    "journal in " + config.journal_directory + " needs its snapshots to recover");
+        }
+        if (recovery.last_sequence != 0 && record.sequence != recovery.last_sequence + 1) {
+            recovery.damaged = true;  // The journal after the snapshot is gone
+            break;
+        }
+        if (record.type == JournalRecord::Type::RegisterSymbol) {
+            // Ids are handed out in registration order, so replaying the
+            // registrations reproduces them unless max_symbols shrank
+            if (register_symbol(std::string(name)) != record.symbol) {
+                throw_symbols_do_not_fit();
+            }
+        } else {
+            if (record.symbol >= order_books.size()) {
+                throw_symbols_do_not_fit();
+            }
+            // No thread is running yet, so fills are booked in place
+            fills.clear();
+            replay_record(record, order_books[record.symbol], fills);
+            for (const Fill& fill : fills) {
+                positions.apply(record.symbol, fill);
+            }
+            if (record.type == JournalRecord::Type::Submit) {
+                last_order_sequence = std::max(last_order_sequence, record.order_id >> kOrderIdSymbolBits);
+            }
+        }
+        ++recovery.replayed;
+        recovery.last_sequence = record.sequence;
+    }
+
+    recovery.damaged = recovery.damaged || reader.damaged();
+    if (recovery.damaged) {
+        // Segments nothing can read past are moved aside, or commands
+        // journaled after them would be lost to the next recovery too
+        if (int error = reader.set_aside_unread(); error != 0) {
+            throw std::system_error(error, std::generic_category(),
+                                    "cannot set aside damaged journal in " + config.journal_directory);
+        }
+    }
+    // New orders continue the journaled id sequence instead of reusing ids
+    next_order_sequence.store(last_order_sequence + 1, std::memory_order_relaxed);
+}
+
+void ExecutionEngine::throw_symbols_do_not_fit() const {
+    // Not damage: the journal is intact and a larger max_symbols recovers it
+    throw std::system_error(EINVAL, std::generic_category(),
+                            "journal in " + config.journal_directory + " has more symbols than max_symbols");
+}
+
+void ExecutionEngine::save_state(SnapshotImage& image) const {
+    image.sequence = recovery.last_sequence;
+    image.next_order_sequence = next_order_sequence.load(std::memory_order_relaxed);
+    image.taken_at = wall_clock_ns();
+    image.symbols.resize(order_books.size());
+    for (std::size_t id = 0; id < order_books.size(); ++id) {
+        image.symbols[id].name = symbols.name(static_cast<SymbolId>(id));
+        order_books[id].save(image.symbols[id].book);
+    }
+    positions.save(image.positions);
+}
+
+void ExecutionEngine::restore_state(const SnapshotImage& image) {
+    for (std::size_t id = 0; id < image.symbols.size(); ++id) {
+        if (register_symbol(image.symbols[id].name) != id) {
+            throw_symbols_do_not_fit();
+        }
+        order_books[id].restore(image.symbols[id].book);
+    }
+    positions.restore(image.positions);
+    next_order_sequence.store(image.next_order_sequence, std::memory_order_relaxed);
+}
+
+SymbolId ExecutionEngine::register_symbol(const std::string& symbol) {
+    // Known symbols, which is nearly every call from the string submit
+    // paths, resolve without the lock; only a new one takes it
+    SymbolId id = find_symbol(symbol);
+    if (id != kInvalidSymbol) {
+        return id;
+    }
     std::lock_guard<std::mutex> lock(engine_mutex);
+    return register_symbol_locked(symbol);
+}
 
-    // Create order book if it doesn't exist
-    auto [it, inserted] = order_books.try_emplace(order.symbol, OrderBook(order.symbol));
+SymbolId ExecutionEngine::find_symbol(const std::string& symbol) const {
+    // A name is indexed just before its book is published, so the id only
+    // counts once the book is there
+    SymbolId id = symbols.find(symbol);
+    return id < order_books.size() ? id : kInvalidSymbol;
+}
 
-    // Generate order ID and submit order
-    Order order_with_id = order;
-    order_with_id.order_id = generate_order_id();
-    
-    it->second.add_order(order_with_id);
-    
-    return order_with_id.order_id;
+SymbolId ExecutionEngine::register_symbol_locked(const std::string& symbol) {
+    SymbolId id = symbols.find(symbol);
+    if (id != kInvalidSymbol) {
+        return id;
+    }
+    if (order_books.size() == order_books.capacity()) {
+        return kInvalidSymbol;
+    }
+
+    id = symbols.intern(symbol);
+    market_data_callbacks.emplace_back();
+    market_data_rates.emplace_back(config.market_data_rate);
+    trade_callbacks.emplace_back();
+    depth_callbacks.emplace_back();
+    journal_sequencers.emplace_back();
+    // Registry names never move, and the record is queued before the id
+    // can be used, so it precedes every command for the symbol
+    if (journal) {
+        journal->append_symbol(id, symbols.name(id));
+    }
+    // Publishing the book last makes the id visible to lock-free readers
+    order_books.emplace_back(symbol, id);
+    return id;
+}
+
+std::string ExecutionEngine::submit_order(const Order& order) {
+    // Only a resting limit order can keep a reserve behind its display
+    if (order.display_quantity > 0 && order.type != OrderType::Limit) {
+        return std::string();
+    }
+
+    OrderId order_id = 0;
+    if (is_stop_order(order.type)) {
+        order_id = submit_stop_order(register_symbol(order.symbol), to_ticks(order.stop_price), order.quantity,
+                                     order.is_buy, order.type, to_ticks(order.price), order.account);
+    } else if (order.display_quantity > 0) {
+        order_id = submit_iceberg_order(register_symbol(order.symbol), to_ticks(order.price), order.quantity,
+                                        order.is_buy, order.display_quantity, order.account);
+    } else {
+        order_id = submit_order(register_symbol(order.symbol), to_ticks(order.price), order.quantity,
+                                order.is_buy, order.type, order.account);
+    }
+    return order_id != 0 ? order_id_to_string(order_id) : std::string();
+}
+
+OrderId ExecutionEngine::submit_order(const std::string& symbol, Price price, int quantity, bool is_buy,
+                                      OrderType type) {
+    return submit_order(register_symbol(symbol), price, quantity, is_buy, type);
+}
+
+OrderId ExecutionEngine::submit_order(SymbolId symbol, Price price, int quantity, bool is_buy,
+                                      OrderType type, AccountId account) {
+    if (symbol >= order_books.size()) {
+        return 0;
+    }
+
+    OrderId order_id = make_order_id(next_order_sequence.fetch_add(1, std::memory_order_relaxed), symbol);
+    execute(MatchingCommand{MatchingCommand::Type::Submit, symbol,
+                            BookOrder{order_id, price, quantity, is_buy, type, 0, price, account}});
+    return order_id;
+}
+
+OrderId ExecutionEngine::submit_iceberg_order(SymbolId symbol, Price price, int quantity, bool is_buy,
+                                              int display_quantity, AccountId account) {
+    if (symbol >= order_books.size()) {
+        return 0;
+    }
+
+    OrderId order_id = make_order_id(next_order_sequence.fetch_add(1, std::memory_order_relaxed), symbol);
+    execute(MatchingCommand{MatchingCommand::Type::Submit, symbol,
+                            BookOrder{order_id, price, quantity, is_buy, OrderType::Limit,
+                                      display_quantity, 0, account}});
+    return order_id;
+}
+
+OrderId ExecutionEngine::submit_stop_order(SymbolId symbol, Price stop_price, int quantity, bool is_buy,
+                                           OrderType type, Price limit_price, AccountId account) {
+    if (symbol >= order_books.size() || !is_stop_order(type)) {
+        return 0;
+    }
+
+    OrderId order_id = make_order_id(next_order_sequence.fetch_add(1, std::memory_order_relaxed), symbol);
+    execute(MatchingCommand{MatchingCommand::Type::Submit, symbol,
+                            BookOrder{order_id, limit_price, quantity, is_buy, type, 0, stop_price, account}});
+    return order_id;
+}
+
+OrderId ExecutionEngine::submit_order_async(SymbolId symbol, Price price, int quantity, bool is_buy,
+                                            OrderType type, AccountId account) {
+    if (symbol >= order_books.size()) {
+        return 0;
+    }
+
+    OrderId order_id = make_order_id(next_order_sequence.fetch_add(1, std::memory_order_relaxed), symbol);
+    bool queued = post(MatchingCommand{MatchingCommand::Type::Submit, symbol,
+                                       BookOrder{order_id, price, quantity, is_buy, type, 0, price, account}});
+    return queued ? order_id : 0;
+}
+
+bool ExecutionEngine::cancel_order(const std::string& order_id) {
+    return cancel_order(parse_order_id(order_id));
+}
+
+bool ExecutionEngine::cancel_order(OrderId order_id) {
+    SymbolId symbol = order_id_symbol(order_id);
+    if (order_id == 0 || symbol >= order_books.size()) {
+        return false;
+    }
+    return execute(MatchingCommand{MatchingCommand::Type::Cancel, symbol,
+                                   BookOrder{order_id, 0, 0, false}}) != 0;
+}
+
+bool ExecutionEngine::modify_order(const std::string& order_id, double price, int quantity) {
+    return modify_order(parse_order_id(order_id), to_ticks(price), quantity);
+}
+
+bool ExecutionEngine::modify_order(OrderId order_id, Price price, int quantity) {
+    SymbolId symbol = order_id_symbol(order_id);
+    if (order_id == 0 || symbol >= order_books.size()) {
+        return false;
+    }
+    return execute(MatchingCommand{MatchingCommand::Type::Modify, symbol,
+                                   BookOrder{order_id, price, quantity, false}}) != 0;
+}
+
+std::size_t ExecutionEngine::cancel_all_orders(const std::string& symbol) {
+    SymbolId id = find_symbol(symbol);
+    if (id == kInvalidSymbol) {
+        return 0;
+    }
+    return execute(MatchingCommand{MatchingCommand::Type::CancelAll, id, BookOrder{}});
 }
 
 void ExecutionEngine::subscribe_market_data(const std::string& symbol, MarketDataCallback callback) {
     std::lock_guard<std::mutex> lock(engine_mutex);
-    market_data_callbacks[symbol].push_back(callback);
+    SymbolId id = register_symbol_locked(symbol);
+    if (id != kInvalidSymbol) {
+        market_data_callbacks[id].add(std::move(callback));
+    }
 }
 
 void ExecutionEngine::unsubscribe_market_data(const std::string& symbol) {
     std::lock_guard<std::mutex> lock(engine_mutex);
-    market_data_callbacks.erase(symbol);
+    SymbolId id = symbols.find(symbol);
+    if (id != kInvalidSymbol) {
+        market_data_callbacks[id].clear();
+    }
+}
+
+void ExecutionEngine::set_market_data_rate(const std::string& symbol, double ticks_per_second) {
+    std::lock_guard<std::mutex> lock(engine_mutex);
+    SymbolId id = register_symbol_locked(symbol);
+    if (id != kInvalidSymbol) {
+        market_data_rates[id].store(ticks_per_second, std::memory_order_relaxed);
+    }
 }
 
 void ExecutionEngine::subscribe_trades(const std::string& symbol, TradeCallback callback) {
     std::lock_guard<std::mutex> lock(engine_mutex);
-    trade_callbacks[symbol].push_back(callback);
+    SymbolId id = register_symbol_locked(symbol);
+    if (id != kInvalidSymbol) {
+        trade_callbacks[id].add(std::move(callback));
+    }
 }
 
 void ExecutionEngine::unsubscribe_trades(const std::string& symbol) {
     std::lock_guard<std::mutex> lock(engine_mutex);
-    trade_callbacks.erase(symbol);
+    SymbolId id = symbols.find(symbol);
+    if (id != kInvalidSymbol) {
+        trade_callbacks[id].clear();
+    }
 }
 
-int ExecutionEngine::get_position(const std::string& symbol) const {
+void ExecutionEngine::subscribe_depth(const std::string& symbol, DepthCallback callback) {
     std::lock_guard<std::mutex> lock(engine_mutex);
-    auto it = order_books.find(symbol);
-    return it != order_books.end() ? it->second.get_position() : 0;
+    SymbolId id = register_symbol_locked(symbol);
+    if (id != kInvalidSymbol) {
+        depth_callbacks[id].add(std::move(callback));
+    }
 }
 
-double ExecutionEngine::get_average_price(const std::string& symbol) const {
+void ExecutionEngine::unsubscribe_depth(const std::string& symbol) {
     std::lock_guard<std::mutex> lock(engine_mutex);
-    auto it = order_books.find(symbol);
-    return it != order_books.end() ? it->second.get_average_price() : 0.0;
+    SymbolId id = symbols.find(symbol);
+    if (id != kInvalidSymbol) {
+        depth_callbacks[id].clear();
+    }
+}
+
+L3Reader ExecutionEngine::open_l3_feed(const std::string& symbol) {
+    return open_l3_feed(find_symbol(symbol));
+}
+
+L3Reader ExecutionEngine::open_l3_feed(SymbolId symbol) {
+    if (symbol >= order_books.size()) {
+        return L3Reader();
+    }
+    return L3Reader(order_books[symbol].open_l3_feed(config.l3_ring_capacity));
+}
+
+DepthSnapshot ExecutionEngine::get_depth(const std::string& symbol, std::size_t levels) const {
+    DepthSnapshot snapshot;
+    get_depth(find_symbol(symbol), levels, snapshot);
+    return snapshot;
+}
+
+int ExecutionEngine::journal_error() const {
+    return journal ? journal->error() : 0;
+}
+
+const RecoveryStats& ExecutionEngine::recovery_stats() const {
+    return recovery;
+}
+
+std::uint64_t ExecutionEngine::snapshot() {
+    if (!snapshotter) {
+        return 0;
+    }
+    // The replica only sees records once they are on disk
+    std::uint64_t sequence = journal->appended_sequence();
+    if (!journal->wait_durable(sequence)) {
+        return 0;
+    }
+    return snapshotter->take(sequence);
+}
+
+void ExecutionEngine::get_depth(SymbolId symbol, std::size_t levels, DepthSnapshot& out) const {
+    if (symbol >= order_books.size()) {
+        out.bids.clear();
+        out.asks.clear();
+        out.sequence = 0;
+        return;
+    }
+    order_books[symbol].get_depth(levels, out);
+}
+
+int ExecutionEngine::get_position(const std::string& symbol) const {
+    return get_position(kDefaultAccount, symbol);
+}
+
+double ExecutionEngine::get_average_price(const std::string& symbol) const {
+    return get_average_price(kDefaultAccount, symbol);
 }
 
 double ExecutionEngine::get_unrealized_pnl(const std::string& symbol) const {
-    std::lock_guard<std::mutex> lock(engine_mutex);
-    auto it = order_books.find(symbol);
-    return it != order_books.end() ? it->second.get_unrealized_pnl() : 0.0;
+    return get_unrealized_pnl(kDefaultAccount, symbol);
 }
 
 double ExecutionEngine::get_realized_pnl(const std::string& symbol) const {
-    std::lock_guard<std::mutex> lock(engine_mutex);
-    auto it = order_books.find(symbol);
-    return it != order_books.end() ? it->second.get_realized_pnl() : 0.0;
+    return get_realized_pnl(kDefaultAccount, symbol);
+}
+
+int ExecutionEngine::get_position(AccountId account, const std::string& symbol) const {
+    return get_position(account, find_symbol(symbol));
+}
+
+double ExecutionEngine::get_average_price(AccountId account, const std::string& symbol) const {
+    return get_average_price(account, find_symbol(symbol));
+}
+
+double ExecutionEngine::get_unrealized_pnl(AccountId account, const std::string& symbol) const {
+    return get_unrealized_pnl(account, find_symbol(symbol));
+}
+
+double ExecutionEngine::get_realized_pnl(AccountId account, const std::string& symbol) const {
+    return get_realized_pnl(account, find_symbol(symbol));
+}
+
+int ExecutionEngine::get_position(AccountId account, SymbolId symbol) const {
+    return get_position_snapshot(account, symbol).quantity;
+}
+
+double ExecutionEngine::get_average_price(AccountId account, SymbolId symbol) const {
+    return get_position_snapshot(account, symbol).average_price;
+}
+
+double ExecutionEngine::get_unrealized_pnl(AccountId account, SymbolId symbol) const {
+    Position position = get_position_snapshot(account, symbol);
+    return position.quantity != 0 ? position.unrealized_pnl(get_top_of_book(symbol).mark_price()) : 0.0;
+}
+
+double ExecutionEngine::get_realized_pnl(AccountId account, SymbolId symbol) const {
+    return get_position_snapshot(account, symbol).realized_pnl;
+}
+
+Position ExecutionEngine::get_position_snapshot(AccountId account, SymbolId symbol) const {
+    return symbol < order_books.size() ? positions.get(account, symbol) : Position{};
+}
+
+double ExecutionEngine::get_best_bid(const std::string& symbol) const {
+    return get_best_bid(find_symbol(symbol));
+}
+
+double ExecutionEngine::get_best_ask(const std::string& symbol) const {
+    return get_best_ask(find_symbol(symbol));
+}
+
+double ExecutionEngine::get_best_bid(SymbolId symbol) const {
+    return from_ticks(get_top_of_book(symbol).best_bid);
+}
+
+double ExecutionEngine::get_best_ask(SymbolId symbol) const {
+    return from_ticks(get_top_of_book(symbol).best_ask);
+}
+
+TopOfBook ExecutionEngine::get_top_of_book(SymbolId symbol) const {
+    return symbol < order_books.size() ? order_books[symbol].get_top_of_book() : TopOfBook{};
+}
+
+void ExecutionEngine::get_position_snapshots(AccountId account, std::span<const SymbolId> symbols,
+                                             std::span<Position> out) const {
+    // Unknown ids simply miss in the keeper and come back flat
+    positions.get(account, symbols, out);
+}
+
+void ExecutionEngine::get_top_of_books(std::span<const SymbolId> symbols, std::span<TopOfBook> out) const {
+    for (std::size_t i = 0; i < symbols.size(); ++i) {
+        out[i] = get_top_of_book(symbols[i]);
+    }
 }
 
 } // namespace trading
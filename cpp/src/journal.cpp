@@ -0,0 +1,564 @@
+#include "journal.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <string_view>
+#include <system_error>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace trading {
+
+namespace {
+
+// Upper bound on one group commit, so a deep backlog is flushed in pieces
+// and early waiters are not held for the whole of it
+constexpr std::size_t kMaxBatchBytes = std::size_t{1} << 20;
+constexpr std::size_t kMinSegmentBytes = std::size_t{1} << 20;
+
+int sync_data(int fd) {
+#ifdef __APPLE__
+    return ::fsync(fd);
+#else
+    return ::fdatasync(fd);
+#endif
+}
+
+// Returns 0 or an errno value
+int write_all(int fd, const char* data, std::size_t size, std::size_t offset) {
+    while (size > 0) {
+        ssize_t written = ::pwrite(fd, data, size, static_cast<off_t>(offset));
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return errno;
+        }
+        data += written;
+        size -= static_cast<std::size_t>(written);
+        offset += static_cast<std::size_t>(written);
+    }
+    return 0;
+}
+
+// Reserves the whole segment up front so appends never grow the file and
+// fdatasync has no size change to flush. Filesystems without fallocate get
+// a sparse file, which still reads back as zeros past the last entry.
+int preallocate(int fd, std::size_t size) {
+#ifdef __linux__
+    int result = ::posix_fallocate(fd, 0, static_cast<off_t>(size));
+    if (result != EOPNOTSUPP && result != EINVAL) {
+        return result;
+    }
+#endif
+    return ::ftruncate(fd, static_cast<off_t>(size)) == 0 ? 0 : errno;
+}
+
+constexpr const char* kDamagedSuffix = ".damaged";
+
+// Segments already in the directory, by index. Segments set aside as
+// damaged are only listed when asked for.
+std::vector<std::pair<std::uint64_t, std::string>> list_segments(const std::string& directory,
+                                                                 bool include_damaged = false) {
+    std::vector<std::pair<std::uint64_t, std::string>> segments;
+    std::error_code error;
+    for (const auto& file : std::filesystem::directory_iterator(directory, error)) {
+        std::string name = file.path().filename().string();
+        unsigned long long index = 0;
+        int end = 0;
+        if (std::sscanf(name.c_str(), "journal-%llu.log%n", &index, &end) != 1 || end == 0) {
+            continue;
+        }
+        std::string_view suffix = std::string_view(name).substr(static_cast<std::size_t>(end));
+        if (suffix.empty() || (include_damaged && suffix == kDamagedSuffix)) {
+            segments.emplace_back(index, file.path().string());
+        }
+    }
+    std::sort(segments.begin(), segments.end());
+    return segments;
+}
+
+// False if the file is missing or does not start with a segment header
+bool read_segment_header(const std::string& path, JournalSegmentHeader& header) {
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    bool readable = fd >= 0 && ::pread(fd, &header, sizeof(header), 0) == sizeof(header) &&
+                    std::memcmp(header.magic, kJournalMagic, sizeof(header.magic)) == 0;
+    if (fd >= 0) {
+        ::close(fd);
+    }
+    return readable;
+}
+
+int sync_directory(const std::string& directory) {
+    int directory_fd = ::open(directory.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    int result = directory_fd < 0 || ::fsync(directory_fd) != 0 ? errno : 0;
+    if (directory_fd >= 0) {
+        ::close(directory_fd);
+    }
+    return result;
+}
+
+} // anonymous namespace
+
+std::uint32_t journal_checksum(const void* data, std::size_t size) {
+    constexpr std::uint64_t kPrime = 1099511628211ull;
+    const auto* bytes = static_cast<const unsigned char*>(data);
+    std::uint64_t hash = 14695981039346656037ull;
+    for (; size >= sizeof(std::uint64_t); size -= sizeof(std::uint64_t), bytes += sizeof(std::uint64_t)) {
+        std::uint64_t word;
+        std::memcpy(&word, bytes, sizeof(word));
+        hash = (hash ^ word) * kPrime;
+    }
+    for (; size > 0; --size, ++bytes) {
+        hash = (hash ^ *bytes) * kPrime;
+    }
+    return static_cast<std::uint32_t>(hash ^ (hash >> 32));
+}
+
+std::string journal_segment_path(const std::string& directory, std::uint64_t segment_index) {
+    char name[40];
+    std::snprintf(name, sizeof(name), "journal-%010llu.log", static_cast<unsigned long long>(segment_index));
+    return (std::filesystem::path(directory) / name).string();
+}
+
+std::size_t prune_journal(const std::string& directory, std::uint64_t sequence) {
+    // A segment holds nothing after sequence if the one after it starts at
+    // or before sequence + 1, so the last segment is never a candidate
+    auto segments = list_segments(directory);
+    std::size_t pruned = 0;
+    for (std::size_t i = 0; i + 1 < segments.size(); ++i) {
+        JournalSegmentHeader header{};
+        if (!read_segment_header(segments[i + 1].second, header) || header.first_sequence > sequence + 1) {
+            break;
+        }
+        std::error_code error;
+        if (!std::filesystem::remove(segments[i].second, error)) {
+            break;
+        }
+        ++pruned;
+    }
+    return pruned;
+}
+
+Journal::Journal(const std::string& directory, std::size_t segment_bytes, std::size_t queue_capacity,
+                 std::uint64_t first_sequence, Tap tap)
+    : directory_(directory),
+      segment_bytes_(std::max(segment_bytes, kMinSegmentBytes)),
+      first_sequence_(first_sequence),
+      queue_(queue_capacity),
+      tap_(std::move(tap)),
+      next_sequence_(first_sequence),
+      durable_(first_sequence - 1) {
+    std::filesystem::create_directories(directory_);
+    auto existing = list_segments(directory_, true);
+    // The tail segment is appended to while it has room, so opening and
+    // closing the engine does not leave a file behind each time
+    bool reopened = !existing.empty() && !existing.back().second.ends_with(kDamagedSuffix) &&
+                    reopen_segment(existing.back().first, existing.back().second);
+    if (!reopened && !open_segment(existing.empty() ? 0 : existing.back().first + 1)) {
+        throw std::system_error(error(), std::generic_category(),
+                                "cannot open journal segment in " + directory_);
+    }
+    batch_.reserve(kMaxBatchBytes + sizeof(JournalEntryHeader) + sizeof(JournalRecord));
+    thread_ = std::thread(&Journal::thread_func, this);
+}
+
+Journal::~Journal() {
+    stopping_.store(true, std::memory_order_release);
+    if (thread_.joinable()) {
+        thread_.join();
+    }
+    close_segment();
+}
+
+std::uint64_t Journal::append(JournalRecord& record) {
+    std::size_t position = 0;
+    // Records are never dropped; a full ring holds the caller back until
+    // the journal thread catches up
+    while (!queue_.try_push(Entry{record, nullptr}, position)) {
+        std::this_thread::yield();
+    }
+    // The journal thread numbers entries in the order it pops them, which
+    // is ring order
+    record.sequence = first_sequence_ + position;
+    return record.sequence;
+}
+
+std::uint64_t Journal::append_symbol(SymbolId symbol, const std::string& name) {
+    JournalRecord record{};
+    record.type = JournalRecord::Type::RegisterSymbol;
+    record.symbol = symbol;
+    record.timestamp = wall_clock_ns();
+
+    std::size_t position = 0;
+    while (!queue_.try_push(Entry{record, &name}, position)) {
+        std::this_thread::yield();
+    }
+    return first_sequence_ + position;
+}
+
+void replay_record(const JournalRecord& record, OrderBook& book, std::vector<Fill>& fills) {
+    switch (record.type) {
+        case JournalRecord::Type::Submit:
+            book.add_order(BookOrder{record.order_id, record.price, record.quantity, record.is_buy,
+                                     record.order_type, record.display_quantity, record.stop_price,
+                                     record.account},
+                           &fills, nullptr, record.timestamp);
+            break;
+        case JournalRecord::Type::Cancel:
+            book.cancel(record.order_id, nullptr, record.timestamp);
+            break;
+        case JournalRecord::Type::Modify:
+            book.modify(record.order_id, record.price, record.quantity, &fills, nullptr, record.timestamp);
+            break;
+        case JournalRecord::Type::CancelAll:
+            book.cancel_all(nullptr, record.timestamp);
+            break;
+        case JournalRecord::Type::RegisterSymbol:
+            break;
+    }
+}
+
+bool Journal::wait_durable(std::uint64_t sequence) const {
+    while (true) {
+        // Read the flush count first so a flush that lands after the check
+        // below wakes the wait instead of being missed
+        std::uint64_t flushes = flushes_.load(std::memory_order_acquire);
+        if (durable_.load(std::memory_order_acquire) >= sequence) {
+            return true;
+        }
+        if (error() != 0) {
+            return false;
+        }
+        flushes_.wait(flushes, std::memory_order_acquire);
+    }
+}
+
+void Journal::thread_func() {
+    Entry entry;
+    int idle_rounds = 0;
+
+    while (true) {
+        bool popped = false;
+        while (batch_.size() < kMaxBatchBytes && queue_.try_pop(entry)) {
+            popped = true;
+            entry.record.sequence = next_sequence_;
+            // After a failure entries are still drained so appenders never
+            // block, but nothing more is written
+            if (error() == 0) {
+                write_entry(entry);
+            }
+            ++next_sequence_;
+        }
+        if (popped) {
+            idle_rounds = 0;
+            if (error() == 0 && flush_batch()) {
+                durable_.store(next_sequence_ - 1, std::memory_order_release);
+            }
+            batch_.clear();
+            flushes_.fetch_add(1, std::memory_order_release);
+            flushes_.notify_all();
+            continue;
+        }
+        if (stopping_.load(std::memory_order_acquire)) {
+            return;
+        }
+        if (++idle_rounds < 64) {
+            std::this_thread::yield();
+        } else {
+            std::this_thread::sleep_for(std::chrono::microseconds(50));
+        }
+    }
+}
+
+void Journal::write_entry(const Entry& entry) {
+    std::size_t name_size = entry.name ? entry.name->size() : 0;
+    std::size_t payload_size = sizeof(JournalRecord) + name_size;
+    std::size_t entry_size = sizeof(JournalEntryHeader) + payload_size;
+
+    // Entries never straddle segments; one too big for any segment gets a
+    // fresh one to itself and simply grows it
+    bool segment_has_entries = segment_offset_ + batch_.size() > sizeof(JournalSegmentHeader);
+    if (segment_has_entries && segment_offset_ + batch_.size() + entry_size > segment_bytes_) {
+        if (!flush_batch() || !open_segment(segment_index_ + 1)) {
+            return;
+        }
+        batch_.clear();
+    }
+
+    std::size_t start = batch_.size();
+    batch_.resize(start + entry_size);
+    char* payload = batch_.data() + start + sizeof(JournalEntryHeader);
+    std::memcpy(payload, &entry.record, sizeof(JournalRecord));
+    if (name_size > 0) {
+        std::memcpy(payload + sizeof(JournalRecord), entry.name->data(), name_size);
+    }
+    JournalEntryHeader header{static_cast<std::uint32_t>(payload_size), journal_checksum(payload, payload_size)};
+    std::memcpy(batch_.data() + start, &header, sizeof(header));
+    if (tap_) {
+        batch_entries_.push_back(entry);
+    }
+}
+
+bool Journal::open_segment(std::uint64_t segment_index) {
+    std::string path = journal_segment_path(directory_, segment_index);
+    int fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        fail(errno);
+        return false;
+    }
+
+    JournalSegmentHeader header{};
+    std::memcpy(header.magic, kJournalMagic, sizeof(header.magic));
+    header.version = kJournalVersion;
+    header.segment_index = segment_index;
+    header.first_sequence = next_sequence_;
+
+    int result = preallocate(fd, segment_bytes_);
+    if (result == 0) {
+        result = write_all(fd, reinterpret_cast<const char*>(&header), sizeof(header), 0);
+    }
+    if (result == 0 && sync_data(fd) != 0) {
+        result = errno;
+    }
+    // The new file's directory entry has to be durable too, or a crash
+    // could lose the whole segment
+    if (result == 0) {
+        result = sync_directory(directory_);
+    }
+    if (result != 0) {
+        ::close(fd);
+        fail(result);
+        return false;
+    }
+
+    close_segment();
+    fd_ = fd;
+    segment_index_ = segment_index;
+    segment_offset_ = sizeof(JournalSegmentHeader);
+    return true;
+}
+
+bool Journal::reopen_segment(std::uint64_t segment_index, const std::string& path) {
+    int fd = ::open(path.c_str(), O_RDWR | O_CLOEXEC);
+    struct stat status {};
+    if (fd < 0 || ::fstat(fd, &status) != 0 ||
+        static_cast<std::size_t>(status.st_size) < sizeof(JournalSegmentHeader)) {
+        if (fd >= 0) {
+            ::close(fd);
+        }
+        return false;
+    }
+    std::size_t size = static_cast<std::size_t>(status.st_size);
+    void* mapping = ::mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+    if (mapping == MAP_FAILED) {
+        ::close(fd);
+        return false;
+    }
+
+    // Walks the entries the way JournalReader does, to the first unwritten
+    // or torn one
+    const char* data = static_cast<const char*>(mapping);
+    JournalSegmentHeader header{};
+    std::memcpy(&header, data, sizeof(header));
+    std::uint64_t last_sequence = header.first_sequence - 1;
+    std::size_t end = sizeof(JournalSegmentHeader);
+    while (end + sizeof(JournalEntryHeader) <= size) {
+        JournalEntryHeader entry{};
+        std::memcpy(&entry, data + end, sizeof(entry));
+        const char* payload = data + end + sizeof(entry);
+        JournalRecord record{};
+        if (entry.size < sizeof(JournalRecord) || entry.size > size - end - sizeof(entry) ||
+            journal_checksum(payload, entry.size) != entry.checksum) {
+            break;
+        }
+        std::memcpy(&record, payload, sizeof(record));
+        if (record.sequence != last_sequence + 1) {
+            break;
+        }
+        last_sequence = record.sequence;
+        end += sizeof(entry) + entry.size;
+    }
+    ::munmap(mapping, size);
+
+    // Only a sound segment that ends exactly where this run starts can be
+    // continued; anything else gets a fresh segment after it
+    bool reusable = std::memcmp(header.magic, kJournalMagic, sizeof(header.magic)) == 0 &&
+                    header.version == kJournalVersion && header.segment_index == segment_index &&
+                    last_sequence + 1 == next_sequence_ && end < segment_bytes_;
+    // Cutting the file at the end first zeroes whatever a crash left past
+    // it, so no stale entry can ever line up behind a new one
+    if (!reusable || ::ftruncate(fd, static_cast<off_t>(end)) != 0 || preallocate(fd, segment_bytes_) != 0 ||
+        sync_data(fd) != 0) {
+        ::close(fd);
+        return false;
+    }
+
+    fd_ = fd;
+    segment_index_ = segment_index;
+    segment_offset_ = end;
+    return true;
+}
+
+void Journal::close_segment() {
+    if (fd_ < 0) {
+        return;
+    }
+    // Trimmed to what was written, so a closed segment holds no
+    // preallocated slack. A failed trim only leaves zeros, which read as
+    // the end of the segment anyway.
+    (void)::ftruncate(fd_, static_cast<off_t>(segment_offset_));
+    ::close(fd_);
+    fd_ = -1;
+}
+
+bool Journal::flush_batch() {
+    if (batch_.empty()) {
+        return true;
+    }
+    int result = write_all(fd_, batch_.data(), batch_.size(), segment_offset_);
+    if (result == 0 && sync_data(fd_) != 0) {
+        result = errno;
+    }
+    if (result != 0) {
+        batch_entries_.clear();
+        fail(result);
+        return false;
+    }
+    segment_offset_ += batch_.size();
+    for (const Entry& entry : batch_entries_) {
+        tap_(entry.record, entry.name);
+    }
+    batch_entries_.clear();
+    return true;
+}
+
+void Journal::fail(int error) {
+    int expected = 0;
+    error_.compare_exchange_strong(expected, error != 0 ? error : EIO, std::memory_order_release);
+}
+
+JournalReader::JournalReader(const std::string& directory) : directory_(directory) {
+    for (auto& [index, path] : list_segments(directory)) {
+        segments_.push_back(std::move(path));
+    }
+}
+
+JournalReader::~JournalReader() {
+    close_segment();
+}
+
+void JournalReader::skip_to(std::uint64_t sequence) {
+    // A segment holds nothing after sequence if the one after it starts at
+    // or before sequence + 1
+    while (next_segment_ + 1 < segments_.size()) {
+        JournalSegmentHeader header{};
+        if (!read_segment_header(segments_[next_segment_ + 1], header) || header.first_sequence > sequence + 1) {
+            return;
+        }
+        ++next_segment_;
+    }
+}
+
+bool JournalReader::next(JournalRecord& record, std::string_view& name) {
+    while (true) {
+        if (data_ == nullptr) {
+            if (damaged_ || next_segment_ >= segments_.size() || !open_segment(next_segment_++)) {
+                return false;
+            }
+        }
+
+        JournalEntryHeader header{};
+        bool intact = offset_ + sizeof(header) <= size_;
+        if (intact) {
+            std::memcpy(&header, data_ + offset_, sizeof(header));
+            const char* payload = data_ + offset_ + sizeof(header);
+            intact = header.size >= sizeof(JournalRecord) &&
+                     header.size <= size_ - offset_ - sizeof(header) &&
+                     journal_checksum(payload, header.size) == header.checksum;
+        }
+        if (intact) {
+            const char* payload = data_ + offset_ + sizeof(header);
+            std::memcpy(&record, payload, sizeof(JournalRecord));
+            intact = last_sequence_ == 0 || record.sequence == last_sequence_ + 1;
+            if (intact) {
+                name = std::string_view(payload + sizeof(JournalRecord), header.size - sizeof(JournalRecord));
+                offset_ += sizeof(header) + header.size;
+                last_sequence_ = record.sequence;
+                return true;
+            }
+        }
+        // Unwritten space, or a write the crash tore; the next segment, if
+        // any, picks up after the last intact entry
+        close_segment();
+    }
+}
+
+int JournalReader::set_aside_unread() {
+    close_segment();
+    // next() has already moved past the segment it stopped in
+    std::size_t first = next_segment_ > 0 ? next_segment_ - 1 : 0;
+    for (std::size_t index = first; index < segments_.size(); ++index) {
+        std::string damaged = segments_[index] + kDamagedSuffix;
+        if (::rename(segments_[index].c_str(), damaged.c_str()) != 0) {
+            return errno;
+        }
+        segments_[index] = damaged;
+    }
+    next_segment_ = segments_.size();
+    return first < segments_.size() ? sync_directory(directory_) : 0;
+}
+
+bool JournalReader::open_segment(std::size_t index) {
+    int fd = ::open(segments_[index].c_str(), O_RDONLY | O_CLOEXEC);
+    struct stat status {};
+    if (fd < 0 || ::fstat(fd, &status) != 0 ||
+        static_cast<std::size_t>(status.st_size) < sizeof(JournalSegmentHeader)) {
+        if (fd >= 0) {
+            ::close(fd);
+        }
+        damaged_ = true;
+        return false;
+    }
+
+    std::size_t size = static_cast<std::size_t>(status.st_size);
+    void* data = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (data == MAP_FAILED) {
+        damaged_ = true;
+        return false;
+    }
+    ::madvise(data, size, MADV_SEQUENTIAL);
+
+    JournalSegmentHeader header{};
+    std::memcpy(&header, data, sizeof(header));
+    bool follows_on = last_sequence_ == 0 || header.first_sequence == last_sequence_ + 1;
+    if (std::memcmp(header.magic, kJournalMagic, sizeof(header.magic)) != 0 ||
+        header.version != kJournalVersion || !follows_on) {
+        ::munmap(data, size);
+        damaged_ = true;
+        return false;
+    }
+
+    data_ = static_cast<const char*>(data);
+    size_ = size;
+    offset_ = sizeof(JournalSegmentHeader);
+    return true;
+}
+
+void JournalReader::close_segment() {
+    if (data_ != nullptr) {
+        ::munmap(const_cast<char*>(data_), size_);
+    }
+    data_ = nullptr;
+    size_ = 0;
+    offset_ = 0;
+}
+
+} // namespace trading
@@ -0,0 +1,208 @@
+#include "market_replay.hpp"
+#include <algorithm>
+#include <chrono>
+#include <functional>
+#include <limits>
+#include <memory>
+#include <span>
+#include <thread>
+
+#include "tick_store.hpp"
+
+namespace trading {
+
+namespace {
+
+// Ticks per publish_market_data call: enough to spread the subscriber
+// lookups thin, few enough that stop() is noticed promptly
+constexpr std::size_t kBatchTicks = 512;
+// Up to this many symbols are merged by scanning each one's next tick,
+// which beats a heap when there are few and does not care whether they
+// interleave tick by tick or come in long runs. More go through a heap.
+constexpr std::size_t kScanMergeSymbols = 8;
+// Waits longer than this sleep; shorter ones yield, since sleeping
+// overshoots by about this much
+constexpr auto kSpinThreshold = std::chrono::microseconds(200);
+// Longest single sleep, which bounds how long stop() waits on a long gap
+constexpr auto kMaxSleep = std::chrono::milliseconds(10);
+
+struct Cursor {
+    SymbolId symbol;
+    const std::string* name;
+    std::span<const Timestamp> timestamps;
+    std::span<const double> prices;
+    std::span<const double> volumes;
+    std::size_t next = 0;
+};
+
+} // anonymous namespace
+
+ReplayMarketData::ReplayMarketData(const std::string& directory, double speed, std::vector<std::string> symbols)
+    : directory_(directory), speed_(std::max(speed, 0.0)), symbols_(std::move(symbols)) {}
+
+void ReplayMarketData::reset() {
+    published_.store(0, std::memory_order_relaxed);
+    finished_.store(false, std::memory_order_release);
+}
+
+void ReplayMarketData::run(ExecutionEngine& engine) {
+    using Clock = std::chrono::steady_clock;
+
+    std::vector<std::string> symbols = symbols_.empty() ? tick_store_symbols(directory_) : symbols_;
+    std::vector<std::unique_ptr<TickReader>> readers;
+    std::vector<Cursor> cursors;
+    for (const std::string& symbol : symbols) {
+        auto reader = std::make_unique<TickReader>(directory_, symbol);
+        SymbolId id = reader->empty() ? kInvalidSymbol : engine.register_symbol(symbol);
+        if (id == kInvalidSymbol) {
+            continue;
+        }
+        cursors.push_back(Cursor{id, &reader->symbol(), reader->timestamps(), reader->prices(), reader->volumes()});
+        readers.push_back(std::move(reader));
+    }
+
+    Timestamp origin = std::numeric_limits<Timestamp>::max();
+    for (const Cursor& cursor : cursors) {
+        origin = std::min(origin, cursor.timestamps[0]);
+    }
+    const Clock::time_point start = Clock::now();
+    Clock::time_point now = start;
+
+    // Slots keep their symbol string between batches and only copy a new
+    // one when the symbol changes, so filling a slot is three stores
+    std::vector<MarketData> batch(kBatchTicks);
+    std::vector<const std::string*> batch_names(kBatchTicks, nullptr);
+    std::vector<SymbolId> batch_symbols(kBatchTicks);
+    std::size_t filled = 0;
+
+    auto flush = [&] {
+        if (filled == 0) {
+            return;
+        }
+        engine.publish_market_data(std::span<const SymbolId>(batch_symbols.data(), filled),
+                                   std::span<MarketData>(batch.data(), filled));
+        published_.fetch_add(filled, std::memory_order_relaxed);
+        filled = 0;
+    };
+    // False if the engine was stopped first
+    auto wait_until = [&](Clock::time_point due) {
+        while (now < due) {
+            if (!engine.market_data_running()) {
+                return false;
+            }
+            if (due - now > kSpinThreshold) {
+                std::this_thread::sleep_until(std::min(due - kSpinThreshold, now + kMaxSleep));
+            } else {
+                std::this_thread::yield();
+            }
+            now = Clock::now();
+        }
+        return true;
+    };
+    // Adds the cursor's next tick to the batch, which goes out when it is
+    // full or pacing has to wait, whichever symbols it holds. False if the
+    // engine was stopped.
+    auto emit = [&](Cursor& cursor) {
+        std::size_t i = cursor.next++;
+        if (speed_ > 0.0) {
+            auto due = start + std::chrono::duration_cast<Clock::duration>(
+                std::chrono::duration<double, std::nano>(static_cast<double>(cursor.timestamps[i] - origin) / speed_));
+            // The clock is only read when the cached time says the tick is
+            // early, so a backlog of due ticks goes out unpaced
+            if (due > now) {
+                now = Clock::now();
+                if (due > now) {
+                    flush();
+                    if (!wait_until(due)) {
+                        return false;
+                    }
+                }
+            }
+        }
+
+        MarketData& tick = batch[filled];
+        if (batch_names[filled] != cursor.name) {
+            tick.symbol = *cursor.name;
+            batch_names[filled] = cursor.name;
+        }
+        tick.price = cursor.prices[i];
+        tick.volume = cursor.volumes[i];
+        tick.timestamp = cursor.timestamps[i];
+        batch_symbols[filled] = cursor.symbol;
+        if (++filled == kBatchTicks) {
+            flush();
+            return engine.market_data_running();
+        }
+        return true;
+    };
+
+    // Either way ties go to the symbol listed first, so a replay always
+    // interleaves the same way
+    if (cursors.size() <= kScanMergeSymbols) {
+        // Each symbol's next timestamp, or max once it is done
+        constexpr Timestamp kDone = std::numeric_limits<Timestamp>::max();
+        std::vector<Timestamp> heads;
+        for (const Cursor& cursor : cursors) {
+            heads.push_back(cursor.timestamps[0]);
+        }
+        for (std::size_t active = cursors.size(); active > 0;) {
+            std::size_t best = 0;
+            for (std::size_t index = 1; index < heads.size(); ++index) {
+                if (heads[index] < heads[best]) {
+                    best = index;
+                }
+            }
+            Cursor& cursor = cursors[best];
+            if (!emit(cursor)) {
+                return;
+            }
+            if (cursor.next < cursor.timestamps.size()) {
+                heads[best] = cursor.timestamps[cursor.next];
+            } else {
+                heads[best] = kDone;
+                --active;
+            }
+        }
+    } else {
+        // Min-heap of (next timestamp, cursor index)
+        using Head = std::pair<Timestamp, std::size_t>;
+        std::vector<Head> heap;
+        for (std::size_t index = 0; index < cursors.size(); ++index) {
+            heap.emplace_back(cursors[index].timestamps[0], index);
+        }
+        std::make_heap(heap.begin(), heap.end(), std::greater<>());
+
+        while (!heap.empty()) {
+            std::pop_heap(heap.begin(), heap.end(), std::greater<>());
+            Cursor& cursor = cursors[heap.back().second];
+
+            // A run of one symbol's ticks is taken up to the next tick of
+            // any other symbol, so the heap is only touched when the
+            // symbol changes
+            std::size_t end = cursor.timestamps.size();
+            if (heap.size() > 1) {
+                Head other = heap.front();
+                end = cursor.next + 1;
+                while (end < cursor.timestamps.size() && Head(cursor.timestamps[end], heap.back().second) < other) {
+                    ++end;
+                }
+            }
+            while (cursor.next < end) {
+                if (!emit(cursor)) {
+                    return;
+                }
+            }
+
+            if (cursor.next < cursor.timestamps.size()) {
+                heap.back().first = cursor.timestamps[cursor.next];
+                std::push_heap(heap.begin(), heap.end(), std::greater<>());
+            } else {
+                heap.pop_back();
+            }
+        }
+    }
+    flush();
+    finished_.store(true, std::memory_order_release);
+}
+
+} // namespace trading
@@ -0,0 +1,526 @@
+#include "snapshot.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <limits>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace trading {
+
+namespace {
+
+// On-disk layout: a SnapshotHeader, then a checksummed payload of, per
+// symbol, a SnapshotBook, its name, its resting orders and its stops as
+// SnapshotOrders, and finally every position as a SnapshotPosition
+struct SnapshotHeader {
+    char magic[8];
+    std::uint32_t version;
+    std::uint32_t payload_checksum;
+    std::uint64_t payload_size;
+    std::uint64_t sequence;
+    std::uint64_t next_order_sequence;
+    Timestamp taken_at;
+    std::uint64_t symbol_count;
+    std::uint64_t position_count;
+};
+
+struct SnapshotBook {
+    std::uint64_t order_count;
+    std::uint64_t stop_count;
+    std::uint64_t fill_sequence;
+    std::uint64_t depth_sequence;
+    std::uint64_t l3_sequence;
+    Price last_trade_price;
+    std::uint32_t name_size;
+    std::uint32_t reserved;
+};
+
+struct SnapshotOrder {
+    OrderId order_id;
+    Price price;
+    Price stop_price;
+    std::int32_t quantity;
+    std::int32_t display_quantity;
+    std::int32_t hidden_quantity;
+    AccountId account;
+    OrderType order_type;
+    bool is_buy;
+    std::uint8_t reserved[6];
+};
+
+struct SnapshotPosition {
+    AccountId account;
+    SymbolId symbol;
+    std::int32_t quantity;
+    std::uint32_t reserved;
+    double average_price;
+    double realized_pnl;
+};
+
+static_assert(sizeof(SnapshotHeader) == 64, "SnapshotHeader is a fixed on-disk layout");
+static_assert(sizeof(SnapshotBook) == 56, "SnapshotBook is a fixed on-disk layout");
+static_assert(sizeof(SnapshotOrder) == 48, "SnapshotOrder is a fixed on-disk layout");
+static_assert(sizeof(SnapshotPosition) == 32, "SnapshotPosition is a fixed on-disk layout");
+
+constexpr char kSnapshotMagic[8] = {'T', 'R', 'D', 'S', 'N', 'A', 'P', '\0'};
+constexpr std::uint32_t kSnapshotVersion = 1;
+// Snapshots kept after a new one is written, so a newest one damaged on
+// disk still leaves one to fall back on
+constexpr std::size_t kSnapshotsKept = 2;
+
+template <typename T>
+void append(std::vector<char>& out, const T& value) {
+    const char* bytes = reinterpret_cast<const char*>(&value);
+    out.insert(out.end(), bytes, bytes + sizeof(T));
+}
+
+SnapshotOrder to_snapshot_order(const BookOrder& order, int hidden_quantity) {
+    SnapshotOrder out{};
+    out.order_id = order.order_id;
+    out.price = order.price;
+    out.stop_price = order.stop_price;
+    out.quantity = order.quantity;
+    out.display_quantity = order.display_quantity;
+    out.hidden_quantity = hidden_quantity;
+    out.account = order.account;
+    out.order_type = order.type;
+    out.is_buy = order.is_buy;
+    return out;
+}
+
+BookOrder from_snapshot_order(const SnapshotOrder& order) {
+    return BookOrder{order.order_id, order.price, order.quantity, order.is_buy, order.order_type,
+                     order.display_quantity, order.stop_price, order.account};
+}
+
+// Walks a mapped payload, refusing to read past its end
+class PayloadReader {
+public:
+    PayloadReader(const char* data, std::size_t size) : data_(data), size_(size) {}
+
+    template <typename T>
+    bool read(T& value) {
+        if (size_ - offset_ < sizeof(T)) {
+            return false;
+        }
+        std::memcpy(&value, data_ + offset_, sizeof(T));
+        offset_ += sizeof(T);
+        return true;
+    }
+
+    bool read_string(std::size_t size, std::string& value) {
+        if (size_ - offset_ < size) {
+            return false;
+        }
+        value.assign(data_ + offset_, size);
+        offset_ += size;
+        return true;
+    }
+
+    bool at_end() const { return offset_ == size_; }
+
+private:
+    const char* data_;
+    std::size_t size_;
+    std::size_t offset_ = 0;
+};
+
+bool parse_snapshot(const char* data, std::size_t size, SnapshotImage& image) {
+    SnapshotHeader header{};
+    if (size < sizeof(header)) {
+        return false;
+    }
+    std::memcpy(&header, data, sizeof(header));
+    if (std::memcmp(header.magic, kSnapshotMagic, sizeof(header.magic)) != 0 ||
+        header.version != kSnapshotVersion || header.payload_size != size - sizeof(header)) {
+        return false;
+    }
+    const char* payload = data + sizeof(header);
+    if (journal_checksum(payload, header.payload_size) != header.payload_checksum) {
+        return false;
+    }
+
+    // Counts are only trusted as far as the payload can hold them
+    PayloadReader reader(payload, header.payload_size);
+    if (header.symbol_count > header.payload_size / sizeof(SnapshotBook) ||
+        header.position_count > header.payload_size / sizeof(SnapshotPosition)) {
+        return false;
+    }
+    image.sequence = header.sequence;
+    image.next_order_sequence = header.next_order_sequence;
+    image.taken_at = header.taken_at;
+    image.symbols.resize(header.symbol_count);
+    for (SnapshotImage::Symbol& symbol : image.symbols) {
+        SnapshotBook book{};
+        if (!reader.read(book) || !reader.read_string(book.name_size, symbol.name) ||
+            book.order_count > header.payload_size / sizeof(SnapshotOrder) ||
+            book.stop_count > header.payload_size / sizeof(SnapshotOrder)) {
+            return false;
+        }
+        symbol.book.orders.resize(book.order_count);
+        symbol.book.stops.resize(book.stop_count);
+        SnapshotOrder order{};
+        for (BookState::Resting& resting : symbol.book.orders) {
+            if (!reader.read(order)) {
+                return false;
+            }
+            resting = BookState::Resting{from_snapshot_order(order), order.hidden_quantity};
+        }
+        for (BookOrder& stop : symbol.book.stops) {
+            if (!reader.read(order)) {
+                return false;
+            }
+            stop = from_snapshot_order(order);
+        }
+        symbol.book.last_trade_price = book.last_trade_price;
+        symbol.book.fill_sequence = book.fill_sequence;
+        symbol.book.depth_sequence = book.depth_sequence;
+        symbol.book.l3_sequence = book.l3_sequence;
+    }
+    image.positions.resize(header.position_count);
+    for (PositionKeeper::Entry& entry : image.positions) {
+        SnapshotPosition position{};
+        if (!reader.read(position)) {
+            return false;
+        }
+        entry.account = position.account;
+        entry.symbol = position.symbol;
+        entry.position.quantity = position.quantity;
+        entry.position.average_price = position.average_price;
+        entry.position.realized_pnl = position.realized_pnl;
+    }
+    return reader.at_end();
+}
+
+bool read_snapshot(const std::string& path, SnapshotImage& image) {
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return false;
+    }
+    struct stat status {};
+    if (::fstat(fd, &status) != 0 || status.st_size <= 0) {
+        ::close(fd);
+        return false;
+    }
+    std::size_t size = static_cast<std::size_t>(status.st_size);
+    void* data = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (data == MAP_FAILED) {
+        return false;
+    }
+    ::madvise(data, size, MADV_SEQUENTIAL);
+    bool parsed = parse_snapshot(static_cast<const char*>(data), size, image);
+    ::munmap(data, size);
+    return parsed;
+}
+
+// Snapshots already in the directory, oldest first
+std::vector<std::pair<std::uint64_t, std::string>> list_snapshots(const std::string& directory) {
+    std::vector<std::pair<std::uint64_t, std::string>> snapshots;
+    std::error_code error;
+    for (const auto& file : std::filesystem::directory_iterator(directory, error)) {
+        std::string name = file.path().filename().string();
+        unsigned long long sequence = 0;
+        // Skips the temporary files of writes a crash interrupted
+        if (name.size() > 5 && name.compare(name.size() - 5, 5, ".snap") == 0 &&
+            std::sscanf(name.c_str(), "snapshot-%llu.snap", &sequence) == 1) {
+            snapshots.emplace_back(sequence, file.path().string());
+        }
+    }
+    std::sort(snapshots.begin(), snapshots.end());
+    return snapshots;
+}
+
+// Returns 0 or an errno value
+int write_file(int fd, const char* data, std::size_t size) {
+    while (size > 0) {
+        ssize_t written = ::write(fd, data, size);
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return errno;
+        }
+        data += written;
+        size -= static_cast<std::size_t>(written);
+    }
+    return 0;
+}
+
+} // anonymous namespace
+
+std::string snapshot_path(const std::string& directory, std::uint64_t sequence) {
+    char name[48];
+    std::snprintf(name, sizeof(name), "snapshot-%020llu.snap", static_cast<unsigned long long>(sequence));
+    return (std::filesystem::path(directory) / name).string();
+}
+
+int write_snapshot(const std::string& directory, const SnapshotImage& image) {
+    std::vector<char> payload;
+    std::size_t order_count = 0;
+    for (const SnapshotImage::Symbol& symbol : image.symbols) {
+        order_count += symbol.book.orders.size() + symbol.book.stops.size();
+    }
+    payload.reserve(image.symbols.size() * (sizeof(SnapshotBook) + 16) + order_count * sizeof(SnapshotOrder) +
+                    image.positions.size() * sizeof(SnapshotPosition));
+    for (const SnapshotImage::Symbol& symbol : image.symbols) {
+        SnapshotBook book{};
+        book.order_count = symbol.book.orders.size();
+        book.stop_count = symbol.book.stops.size();
+        book.fill_sequence = symbol.book.fill_sequence;
+        book.depth_sequence = symbol.book.depth_sequence;
+        book.l3_sequence = symbol.book.l3_sequence;
+        book.last_trade_price = symbol.book.last_trade_price;
+        book.name_size = static_cast<std::uint32_t>(symbol.name.size());
+        append(payload, book);
+        payload.insert(payload.end(), symbol.name.begin(), symbol.name.end());
+        for (const BookState::Resting& resting : symbol.book.orders) {
+            append(payload, to_snapshot_order(resting.order, resting.hidden_quantity));
+        }
+        for (const BookOrder& stop : symbol.book.stops) {
+            append(payload, to_snapshot_order(stop, 0));
+        }
+    }
+    for (const PositionKeeper::Entry& entry : image.positions) {
+        SnapshotPosition position{};
+        position.account = entry.account;
+        position.symbol = entry.symbol;
+        position.quantity = entry.position.quantity;
+        position.average_price = entry.position.average_price;
+        position.realized_pnl = entry.position.realized_pnl;
+        append(payload, position);
+    }
+
+    SnapshotHeader header{};
+    std::memcpy(header.magic, kSnapshotMagic, sizeof(header.magic));
+    header.version = kSnapshotVersion;
+    header.payload_checksum = journal_checksum(payload.data(), payload.size());
+    header.payload_size = payload.size();
+    header.sequence = image.sequence;
+    header.next_order_sequence = image.next_order_sequence;
+    header.taken_at = image.taken_at;
+    header.symbol_count = image.symbols.size();
+    header.position_count = image.positions.size();
+
+    std::string path = snapshot_path(directory, image.sequence);
+    std::string temporary = path + ".tmp";
+    int fd = ::open(temporary.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        return errno;
+    }
+    int result = write_file(fd, reinterpret_cast<const char*>(&header), sizeof(header));
+    if (result == 0) {
+        result = write_file(fd, payload.data(), payload.size());
+    }
+    if (result == 0 && ::fsync(fd) != 0) {
+        result = errno;
+    }
+    ::close(fd);
+    if (result == 0 && ::rename(temporary.c_str(), path.c_str()) != 0) {
+        result = errno;
+    }
+    // The rename is only durable once the directory is
+    if (result == 0) {
+        int directory_fd = ::open(directory.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+        if (directory_fd < 0 || ::fsync(directory_fd) != 0) {
+            result = errno;
+        }
+        if (directory_fd >= 0) {
+            ::close(directory_fd);
+        }
+    }
+    if (result != 0) {
+        ::unlink(temporary.c_str());
+    }
+    return result;
+}
+
+bool load_latest_snapshot(const std::string& directory, SnapshotImage& image) {
+    auto snapshots = list_snapshots(directory);
+    for (auto it = snapshots.rbegin(); it != snapshots.rend(); ++it) {
+        if (read_snapshot(it->second, image)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+Snapshotter::Snapshotter(const std::string& directory, const SnapshotImage& image, std::size_t queue_capacity,
+                         double interval_seconds)
+    : directory_(directory),
+      interval_seconds_(interval_seconds),
+      queue_(queue_capacity),
+      sequence_(image.sequence),
+      next_order_sequence_(image.next_order_sequence),
+      last_snapshot_(image.sequence),
+      lowest_request_(std::numeric_limits<std::uint64_t>::max()) {
+    for (std::size_t id = 0; id < image.symbols.size(); ++id) {
+        books_.push_back(std::make_unique<OrderBook>(image.symbols[id].name, static_cast<SymbolId>(id)));
+        books_.back()->restore(image.symbols[id].book);
+    }
+    positions_.restore(image.positions);
+    thread_ = std::thread(&Snapshotter::thread_func, this);
+}
+
+Snapshotter::~Snapshotter() {
+    stopping_.store(true, std::memory_order_release);
+    if (thread_.joinable()) {
+        thread_.join();
+    }
+    if (writer_.joinable()) {
+        writer_.join();
+    }
+}
+
+void Snapshotter::feed(const JournalRecord& record, const std::string* name) {
+    // Records are never dropped; a full ring holds the journal thread back
+    // until the replica catches up
+    while (!queue_.try_push(Entry{record, name})) {
+        std::this_thread::yield();
+    }
+}
+
+std::uint64_t Snapshotter::take(std::uint64_t sequence) {
+    std::promise<std::uint64_t> result;
+    std::future<std::uint64_t> future = result.get_future();
+    {
+        std::lock_guard<std::mutex> lock(requests_mutex_);
+        requests_.push_back(Request{sequence, &result});
+        if (sequence < lowest_request_.load(std::memory_order_relaxed)) {
+            lowest_request_.store(sequence, std::memory_order_release);
+        }
+    }
+    return future.get();
+}
+
+void Snapshotter::thread_func() {
+    using Clock = std::chrono::steady_clock;
+    // Bounds how long a deep backlog can hold off requests and the timer
+    constexpr int kMaxBatch = 4096;
+    const auto interval = std::chrono::duration_cast<Clock::duration>(
+        std::chrono::duration<double>(interval_seconds_));
+    auto next_due = Clock::now() + interval;
+    Entry entry;
+    int idle_rounds = 0;
+
+    while (true) {
+        bool popped = false;
+        for (int i = 0; i < kMaxBatch && queue_.try_pop(entry); ++i) {
+            popped = true;
+            apply(entry);
+        }
+
+        if (lowest_request_.load(std::memory_order_acquire) <= sequence_) {
+            std::vector<Request> ready;
+            {
+                std::lock_guard<std::mutex> lock(requests_mutex_);
+                std::uint64_t lowest = std::numeric_limits<std::uint64_t>::max();
+                auto waiting = std::partition(requests_.begin(), requests_.end(),
+                                              [this](const Request& request) { return request.sequence <= sequence_; });
+                ready.assign(requests_.begin(), waiting);
+                requests_.erase(requests_.begin(), waiting);
+                for (const Request& request : requests_) {
+                    lowest = std::min(lowest, request.sequence);
+                }
+                lowest_request_.store(lowest, std::memory_order_release);
+            }
+            start_snapshot(std::move(ready));
+            next_due = Clock::now() + interval;
+        } else if (interval_seconds_ > 0 && Clock::now() >= next_due) {
+            if (sequence_ > last_snapshot_) {
+                start_snapshot({});
+            }
+            next_due = Clock::now() + interval;
+        }
+
+        if (popped) {
+            idle_rounds = 0;
+            continue;
+        }
+        if (stopping_.load(std::memory_order_acquire)) {
+            // Nothing more will arrive, so waiting requests can never be met
+            std::lock_guard<std::mutex> lock(requests_mutex_);
+            for (const Request& request : requests_) {
+                request.result->set_value(0);
+            }
+            requests_.clear();
+            return;
+        }
+        if (++idle_rounds < 64) {
+            std::this_thread::yield();
+        } else {
+            std::this_thread::sleep_for(std::chrono::microseconds(50));
+        }
+    }
+}
+
+void Snapshotter::apply(const Entry& entry) {
+    const JournalRecord& record = entry.record;
+    sequence_ = record.sequence;
+    if (record.type == JournalRecord::Type::RegisterSymbol) {
+        if (entry.name && record.symbol == books_.size()) {
+            books_.push_back(std::make_unique<OrderBook>(*entry.name, record.symbol));
+        }
+        return;
+    }
+    if (record.symbol >= books_.size()) {
+        return;
+    }
+    fills_.clear();
+    replay_record(record, *books_[record.symbol], fills_);
+    for (const Fill& fill : fills_) {
+        positions_.apply(record.symbol, fill);
+    }
+    if (record.type == JournalRecord::Type::Submit) {
+        next_order_sequence_ = std::max(next_order_sequence_, (record.order_id >> kOrderIdSymbolBits) + 1);
+    }
+}
+
+void Snapshotter::start_snapshot(std::vector<Request> requests) {
+    // Copy into the image the writer is not using, so the copy overlaps
+    // any write still in progress
+    SnapshotImage& image = images_[next_image_];
+    next_image_ ^= 1;
+    image.sequence = sequence_;
+    image.next_order_sequence = next_order_sequence_;
+    image.taken_at = wall_clock_ns();
+    image.symbols.resize(books_.size());
+    for (std::size_t id = 0; id < books_.size(); ++id) {
+        image.symbols[id].name = books_[id]->symbol();
+        books_[id]->save(image.symbols[id].book);
+    }
+    positions_.save(image.positions);
+    last_snapshot_ = sequence_;
+
+    // One write at a time
+    if (writer_.joinable()) {
+        writer_.join();
+    }
+    writer_ = std::thread([this, &image, requests = std::move(requests)] {
+        int error = write_snapshot(directory_, image);
+        if (error == 0) {
+            auto snapshots = list_snapshots(directory_);
+            std::error_code ignored;
+            for (std::size_t i = 0; i + kSnapshotsKept < snapshots.size(); ++i) {
+                std::filesystem::remove(snapshots[i].second, ignored);
+            }
+            // The journal is kept back to the oldest snapshot still on
+            // disk, so recovery can fall back to it if the newest is bad
+            if (snapshots.size() >= kSnapshotsKept) {
+                prune_journal(directory_, snapshots[snapshots.size() - kSnapshotsKept].first);
+            }
+        }
+        for (const Request& request : requests) {
+            request.result->set_value(error == 0 ? image.sequence : 0);
+        }
+    });
+}
+
+} // namespace trading
@@ -0,0 +1,375 @@
+#include "tick_store.hpp"
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <charconv>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <limits>
+#include <string_view>
+#include <system_error>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace trading {
+
+namespace {
+
+constexpr const char* kColumnNames[3] = {"timestamp.col", "price.col", "volume.col"};
+constexpr std::size_t kValueWidth = 8;
+constexpr std::size_t kInitialCapacity = std::size_t{1} << 16;
+
+static_assert(sizeof(Timestamp) == kValueWidth && sizeof(double) == kValueWidth,
+              "Tick columns are 8 bytes wide");
+
+std::size_t file_size(std::size_t capacity) {
+    return sizeof(TickColumnHeader) + capacity * kValueWidth;
+}
+
+bool valid_header(const TickColumnHeader& header) {
+    return std::memcmp(header.magic, kTickMagic, sizeof(header.magic)) == 0 && header.version == kTickVersion &&
+           header.width == kValueWidth;
+}
+
+// The count is read by readers mapping the same file while it is written
+std::atomic_ref<std::uint64_t> column_count(char* data) {
+    return std::atomic_ref<std::uint64_t>(reinterpret_cast<TickColumnHeader*>(data)->count);
+}
+
+bool safe_in_file_name(char c) {
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '-' || c == '_' ||
+           c == '.';
+}
+
+std::string unescape(const std::string& name) {
+    std::string symbol;
+    for (std::size_t i = 0; i < name.size(); ++i) {
+        unsigned value = 0;
+        if (name[i] == '%' && i + 2 < name.size() && std::sscanf(name.c_str() + i + 1, "%2x", &value) == 1) {
+            symbol.push_back(static_cast<char>(value));
+            i += 2;
+        } else {
+            symbol.push_back(name[i]);
+        }
+    }
+    return symbol;
+}
+
+template <typename T>
+bool parse_field(std::string_view text, T& value) {
+    auto [end, error] = std::from_chars(text.data(), text.data() + text.size(), value);
+    return error == std::errc() && end == text.data() + text.size();
+}
+
+bool parse_timestamp(std::string_view text, Timestamp& timestamp) {
+    std::size_t dot = text.find('.');
+    if (dot == std::string_view::npos) {
+        return parse_field(text, timestamp);
+    }
+
+    // Decimal seconds are split at the point and each side parsed as an
+    // integer, since a double cannot hold epoch nanoseconds exactly
+    bool negative = !text.empty() && text.front() == '-';
+    std::string_view whole = text.substr(negative ? 1 : 0, dot - (negative ? 1 : 0));
+    std::string_view fraction = text.substr(dot + 1);
+    if (whole.empty() && fraction.empty()) {
+        return false;
+    }
+    Timestamp seconds = 0;
+    if (!whole.empty() && (whole.front() == '-' || whole.front() == '+' || !parse_field(whole, seconds))) {
+        return false;
+    }
+    // Digits past nanoseconds round the last one
+    Timestamp nanoseconds = 0;
+    for (std::size_t i = 0; i < fraction.size(); ++i) {
+        char c = fraction[i];
+        if (c < '0' || c > '9') {
+            return false;
+        }
+        if (i < 9) {
+            nanoseconds = nanoseconds * 10 + (c - '0');
+        } else if (i == 9 && c >= '5') {
+            ++nanoseconds;
+        }
+    }
+    for (std::size_t i = fraction.size(); i < 9; ++i) {
+        nanoseconds *= 10;
+    }
+
+    constexpr Timestamp kNanosPerSecond = 1'000'000'000;
+    if (seconds > (std::numeric_limits<Timestamp>::max() - nanoseconds) / kNanosPerSecond) {
+        return false;
+    }
+    timestamp = seconds * kNanosPerSecond + nanoseconds;
+    if (negative) {
+        timestamp = -timestamp;
+    }
+    return true;
+}
+
+} // anonymous namespace
+
+TickImportStats import_ticks_csv(const std::string& csv_path, const std::string& directory) {
+    std::ifstream file(csv_path);
+    if (!file) {
+        throw std::system_error(errno, std::generic_category(), "cannot read " + csv_path);
+    }
+
+    TickImportStats stats;
+    std::unordered_map<std::string, std::unique_ptr<TickWriter>> writers;
+    // Tapes tend to come in runs of one symbol, so most lines skip the map
+    TickWriter* writer = nullptr;
+    std::string line;
+    while (std::getline(file, line)) {
+        std::string_view rest(line);
+        if (!rest.empty() && rest.back() == '\r') {
+            rest.remove_suffix(1);
+        }
+        std::string_view fields[4];
+        std::size_t count = 0;
+        for (; count < 4; ++count) {
+            std::size_t comma = rest.find(',');
+            fields[count] = rest.substr(0, comma);
+            if (comma == std::string_view::npos) {
+                rest = {};
+                ++count;
+                break;
+            }
+            rest.remove_prefix(comma + 1);
+        }
+
+        Timestamp timestamp = 0;
+        double price = 0.0;
+        double volume = 0.0;
+        if (count != 4 || !rest.empty() || fields[0].empty() || !parse_timestamp(fields[1], timestamp) ||
+            !parse_field(fields[2], price) || !parse_field(fields[3], volume)) {
+            ++stats.skipped;
+            continue;
+        }
+
+        if (writer == nullptr || writer->symbol() != fields[0]) {
+            auto& slot = writers[std::string(fields[0])];
+            if (!slot) {
+                slot = std::make_unique<TickWriter>(directory, std::string(fields[0]));
+            }
+            writer = slot.get();
+        }
+        if (!writer->append(timestamp, price, volume)) {
+            throw std::system_error(ENOSPC, std::generic_category(), "cannot grow tick store for " + writer->symbol());
+        }
+        ++stats.imported;
+    }
+    return stats;
+}
+
+std::string tick_store_symbol_path(const std::string& directory, const std::string& symbol) {
+    std::string name;
+    for (std::size_t i = 0; i < symbol.size(); ++i) {
+        char c = symbol[i];
+        // A leading dot would make "." or ".." or a hidden directory
+        if (safe_in_file_name(c) && !(c == '.' && i == 0)) {
+            name.push_back(c);
+        } else {
+            char escaped[4];
+            std::snprintf(escaped, sizeof(escaped), "%%%02X", static_cast<unsigned char>(c));
+            name += escaped;
+        }
+    }
+    return (std::filesystem::path(directory) / name).string();
+}
+
+std::vector<std::string> tick_store_symbols(const std::string& directory) {
+    std::vector<std::string> symbols;
+    std::error_code error;
+    for (const auto& entry : std::filesystem::directory_iterator(directory, error)) {
+        if (std::filesystem::exists(entry.path() / kColumnNames[0], error)) {
+            symbols.push_back(unescape(entry.path().filename().string()));
+        }
+    }
+    std::sort(symbols.begin(), symbols.end());
+    return symbols;
+}
+
+TickWriter::TickWriter(const std::string& directory, const std::string& symbol) : symbol_(symbol) {
+    std::string path = tick_store_symbol_path(directory, symbol);
+    std::error_code error;
+    std::filesystem::create_directories(path, error);
+    if (error) {
+        throw std::system_error(error, "cannot create tick store for " + symbol);
+    }
+    // The destructor does not run for a constructor that throws
+    auto fail = [this](int error_number, const std::string& what) {
+        for (Column& column : columns_) {
+            if (column.data != nullptr) {
+                ::munmap(column.data, column.mapped);
+            }
+            if (column.fd >= 0) {
+                ::close(column.fd);
+            }
+        }
+        throw std::system_error(error_number, std::generic_category(), what);
+    };
+
+    // Existing columns are appended to. After a crash they may disagree by
+    // the tick that was being written, so the shortest one wins.
+    std::uint64_t count = UINT64_MAX;
+    for (std::size_t i = 0; i < 3; ++i) {
+        std::string column_path = (std::filesystem::path(path) / kColumnNames[i]).string();
+        Column& column = columns_[i];
+        column.fd = ::open(column_path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+        struct stat status {};
+        if (column.fd < 0 || ::fstat(column.fd, &status) != 0) {
+            fail(errno, "cannot open " + column_path);
+        }
+
+        TickColumnHeader header{};
+        if (static_cast<std::size_t>(status.st_size) < sizeof(header)) {
+            std::memcpy(header.magic, kTickMagic, sizeof(header.magic));
+            header.version = kTickVersion;
+            header.width = kValueWidth;
+            if (::pwrite(column.fd, &header, sizeof(header), 0) != sizeof(header)) {
+                fail(errno, "cannot write " + column_path);
+            }
+        } else if (::pread(column.fd, &header, sizeof(header), 0) != sizeof(header) || !valid_header(header)) {
+            fail(EINVAL, column_path + " is not a tick column");
+        }
+        std::size_t stored = (static_cast<std::size_t>(std::max<off_t>(status.st_size, sizeof(header))) -
+                              sizeof(header)) / kValueWidth;
+        count = std::min<std::uint64_t>({count, header.count, stored});
+    }
+
+    count_ = count;
+    if (!grow(std::max(kInitialCapacity, 2 * count_))) {
+        fail(errno, "cannot map tick store for " + symbol);
+    }
+    for (Column& column : columns_) {
+        column_count(column.data).store(count_, std::memory_order_release);
+    }
+}
+
+TickWriter::~TickWriter() {
+    // Trimmed to what was written, so a closed store has no slack
+    for (Column& column : columns_) {
+        if (column.data != nullptr) {
+            ::munmap(column.data, column.mapped);
+        }
+        if (column.fd >= 0) {
+            // A failed trim only leaves slack; the header count still
+            // bounds readers
+            (void)::ftruncate(column.fd, static_cast<off_t>(file_size(count_)));
+            ::close(column.fd);
+        }
+    }
+}
+
+bool TickWriter::append(Timestamp timestamp, double price, double volume) {
+    if (count_ == capacity_ && !grow(2 * capacity_)) {
+        return false;
+    }
+    std::size_t offset = file_size(count_);
+    std::memcpy(columns_[0].data + offset, &timestamp, kValueWidth);
+    std::memcpy(columns_[1].data + offset, &price, kValueWidth);
+    std::memcpy(columns_[2].data + offset, &volume, kValueWidth);
+    ++count_;
+    for (Column& column : columns_) {
+        column_count(column.data).store(count_, std::memory_order_release);
+    }
+    return true;
+}
+
+bool TickWriter::sync() {
+    bool synced = true;
+    for (Column& column : columns_) {
+        synced = ::msync(column.data, file_size(count_), MS_SYNC) == 0 && synced;
+    }
+    return synced;
+}
+
+bool TickWriter::grow(std::size_t capacity) {
+    std::size_t size = file_size(capacity);
+    for (Column& column : columns_) {
+        if (::ftruncate(column.fd, static_cast<off_t>(size)) != 0) {
+            return false;
+        }
+        void* data = ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, column.fd, 0);
+        if (data == MAP_FAILED) {
+            return false;
+        }
+        if (column.data != nullptr) {
+            ::munmap(column.data, column.mapped);
+        }
+        column.data = static_cast<char*>(data);
+        column.mapped = size;
+    }
+    capacity_ = capacity;
+    return true;
+}
+
+TickReader::TickReader(const std::string& directory, const std::string& symbol) : symbol_(symbol) {
+    std::string path = tick_store_symbol_path(directory, symbol);
+    std::uint64_t count = UINT64_MAX;
+    for (std::size_t i = 0; i < 3 && count > 0; ++i) {
+        std::string column_path = (std::filesystem::path(path) / kColumnNames[i]).string();
+        int fd = ::open(column_path.c_str(), O_RDONLY | O_CLOEXEC);
+        struct stat status {};
+        if (fd < 0 || ::fstat(fd, &status) != 0 ||
+            static_cast<std::size_t>(status.st_size) < sizeof(TickColumnHeader)) {
+            if (fd >= 0) {
+                ::close(fd);
+            }
+            count = 0;
+            break;
+        }
+        std::size_t size = static_cast<std::size_t>(status.st_size);
+        void* data = ::mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+        ::close(fd);
+        if (data == MAP_FAILED) {
+            count = 0;
+            break;
+        }
+        ::madvise(data, size, MADV_SEQUENTIAL);
+        data_[i] = static_cast<const char*>(data);
+        mapped_[i] = size;
+
+        TickColumnHeader header{};
+        std::memcpy(&header, data_[i], sizeof(header));
+        if (!valid_header(header)) {
+            count = 0;
+            break;
+        }
+        // The count is read before any value it covers
+        std::uint64_t written = column_count(const_cast<char*>(data_[i])).load(std::memory_order_acquire);
+        count = std::min<std::uint64_t>({count, written, (size - sizeof(header)) / kValueWidth});
+    }
+    count_ = count == UINT64_MAX ? 0 : count;
+}
+
+TickReader::~TickReader() {
+    for (std::size_t i = 0; i < 3; ++i) {
+        if (data_[i] != nullptr) {
+            ::munmap(const_cast<char*>(data_[i]), mapped_[i]);
+        }
+    }
+}
+
+TickRecorder::TickRecorder(const std::string& directory) : directory_(directory) {}
+
+MarketDataCallback TickRecorder::callback(const std::string& symbol) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto& writer = writers_[symbol];
+    if (!writer) {
+        writer = std::make_unique<TickWriter>(directory_, symbol);
+    }
+    return [writer = writer.get(), dropped = &dropped_](const MarketData& tick) {
+        if (!writer->append(tick)) {
+            dropped->fetch_add(1, std::memory_order_relaxed);
+        }
+    };
+}
+
+} // namespace trading
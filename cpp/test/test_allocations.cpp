@@ -0,0 +1,92 @@
+#include "execution_engine.hpp"
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+#include "test_support.hpp"
+
+using namespace trading;
+
+// Every global allocation in the process goes through these, so a test can
+// count what a stretch of code allocated on any thread
+namespace {
+
+std::atomic<std::size_t> allocations{0};
+
+void* counted_allocate(std::size_t size) {
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    if (void* memory = std::malloc(size == 0 ? 1 : size)) {
+        return memory;
+    }
+    throw std::bad_alloc();
+}
+
+} // anonymous namespace
+
+void* operator new(std::size_t size) { return counted_allocate(size); }
+void* operator new[](std::size_t size) { return counted_allocate(size); }
+void operator delete(void* memory) noexcept { std::free(memory); }
+void operator delete[](void* memory) noexcept { std::free(memory); }
+void operator delete(void* memory, std::size_t) noexcept { std::free(memory); }
+void operator delete[](void* memory, std::size_t) noexcept { std::free(memory); }
+
+namespace {
+
+// One round of resting, matching against and cancelling orders on both
+// sides, so nodes, levels and index entries are all created and released
+void churn(ExecutionEngine& engine, SymbolId symbol) {
+    OrderId resting_bid = engine.submit_order(symbol, to_ticks(99.0), 10, true);
+    OrderId resting_ask = engine.submit_order(symbol, to_ticks(101.0), 10, false);
+    engine.submit_order(symbol, to_ticks(100.0), 5, true);
+    engine.submit_order(symbol, to_ticks(100.0), 5, false);
+    engine.submit_order(symbol, to_ticks(99.0), 4, false);
+    engine.modify_order(resting_ask, to_ticks(101.0), 6);
+    engine.submit_order(symbol, to_ticks(0.0), 2, true, OrderType::Market);
+    engine.cancel_order(resting_bid);
+    engine.cancel_order(resting_ask);
+}
+
+} // anonymous namespace
+
+TEST_CASE(steady_state_matching_does_not_allocate) {
+    EngineConfig config;
+    config.dispatch_threads = 0;
+    ExecutionEngine engine(config);
+    SymbolId symbol = engine.register_symbol("XYZ");
+    for (int i = 0; i < 1000; ++i) {
+        churn(engine, symbol);
+    }
+
+    std::size_t before = allocations.load();
+    for (int i = 0; i < 10000; ++i) {
+        churn(engine, symbol);
+    }
+    std::size_t allocated = allocations.load() - before;
+    if (allocated != 0) {
+        std::fprintf(stderr, "%zu allocations over 10000 rounds\n", allocated);
+    }
+    CHECK(allocated == 0);
+}
+
+TEST_CASE(steady_state_matching_on_a_matching_thread_does_not_allocate) {
+    EngineConfig config;
+    config.matching_threads = 1;
+    config.dispatch_threads = 0;
+    ExecutionEngine engine(config);
+    SymbolId symbol = engine.register_symbol("XYZ");
+    for (int i = 0; i < 1000; ++i) {
+        churn(engine, symbol);
+    }
+
+    std::size_t before = allocations.load();
+    for (int i = 0; i < 10000; ++i) {
+        churn(engine, symbol);
+    }
+    std::size_t allocated = allocations.load() - before;
+    if (allocated != 0) {
+        std::fprintf(stderr, "%zu allocations over 10000 rounds\n", allocated);
+    }
+    CHECK(allocated == 0);
+}
+
+TEST_MAIN
@@ -0,0 +1,329 @@
+#include "execution_engine.hpp"
+#include <atomic>
+#include <chrono>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "test_support.hpp"
+
+using namespace trading;
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+template <typename Condition>
+bool eventually(Condition condition) {
+    auto deadline = Clock::now() + std::chrono::seconds(5);
+    while (!condition()) {
+        if (Clock::now() > deadline) {
+            return false;
+        }
+        std::this_thread::yield();
+    }
+    return true;
+}
+
+int resting_quantity(const ExecutionEngine& engine, SymbolId symbol) {
+    DepthSnapshot depth;
+    engine.get_depth(symbol, 1000, depth);
+    int quantity = 0;
+    for (const DepthLevel& level : depth.bids) {
+        quantity += level.quantity;
+    }
+    for (const DepthLevel& level : depth.asks) {
+        quantity += level.quantity;
+    }
+    return quantity;
+}
+
+// Publishes a fixed number of ticks per symbol through the batch call
+class CountedSource : public MarketDataSource {
+public:
+    CountedSource(std::vector<SymbolId> symbols, int ticks) : symbols_(std::move(symbols)), ticks_(ticks) {}
+
+    void run(ExecutionEngine& engine) override {
+        std::vector<SymbolId> ids;
+        std::vector<MarketData> batch;
+        for (int i = 0; i < ticks_; ++i) {
+            for (SymbolId symbol : symbols_) {
+                ids.push_back(symbol);
+                batch.push_back(MarketData{"", static_cast<double>(i), 1.0, i, 0});
+            }
+        }
+        engine.publish_market_data(ids, batch);
+        done.store(true, std::memory_order_release);
+    }
+
+    std::atomic<bool> done{false};
+
+private:
+    std::vector<SymbolId> symbols_;
+    int ticks_;
+};
+
+} // anonymous namespace
+
+TEST_CASE(order_ids_carry_their_symbol_and_increase) {
+    ExecutionEngine engine;
+    SymbolId a = engine.register_symbol("AAA");
+    SymbolId b = engine.register_symbol("BBB");
+    OrderId first = engine.submit_order(b, to_ticks(10.0), 1, true);
+    OrderId second = engine.submit_order(a, to_ticks(10.0), 1, true);
+    CHECK(order_id_symbol(first) == b);
+    CHECK(order_id_symbol(second) == a);
+    CHECK(second > first);
+    CHECK(parse_order_id(order_id_to_string(first)) == first);
+    CHECK(parse_order_id("12x") == 0);
+    CHECK(parse_order_id("") == 0);
+    CHECK(engine.submit_order(SymbolId{77}, to_ticks(10.0), 1, true) == 0);
+}
+
+TEST_CASE(prices_round_to_the_nearest_tick) {
+    CHECK(to_ticks(100.0) == 1000000);
+    CHECK(to_ticks(0.1 + 0.2) == 3000);
+    CHECK(to_ticks(99.99996) == 1000000);
+    CHECK(to_ticks(-1.5) == -15000);
+    CHECK(from_ticks(1234567) == 123.4567);
+}
+
+TEST_CASE(symbols_get_dense_ids_up_to_max_symbols) {
+    EngineConfig config;
+    config.max_symbols = 3;
+    ExecutionEngine engine(config);
+    CHECK(engine.register_symbol("A") == 0);
+    CHECK(engine.register_symbol("B") == 1);
+    CHECK(engine.register_symbol("A") == 0);
+    CHECK(engine.register_symbol("C") == 2);
+    CHECK(engine.register_symbol("D") == kInvalidSymbol);
+    CHECK(engine.symbol_count() == 3);
+    CHECK(engine.find_symbol("C") == 2);
+    CHECK(engine.submit_order(Order{"", "D", 1.0, 1, true}).empty());
+}
+
+TEST_CASE(sharded_matching_takes_commands_from_many_threads) {
+    EngineConfig config;
+    config.matching_threads = 3;
+    ExecutionEngine engine(config);
+    constexpr int kSymbols = 8;
+    constexpr int kOrders = 500;
+    std::vector<SymbolId> ids;
+    for (int s = 0; s < kSymbols; ++s) {
+        ids.push_back(engine.register_symbol("S" + std::to_string(s)));
+    }
+
+    // Each thread rests bids on every symbol, cancelling every other one
+    std::vector<std::thread> submitters;
+    for (int t = 0; t < 4; ++t) {
+        submitters.emplace_back([&, t] {
+            for (int i = 0; i < kOrders; ++i) {
+                SymbolId symbol = ids[(i + t) % kSymbols];
+                OrderId order_id = engine.submit_order(symbol, to_ticks(100.0 - t), 1, true);
+                if (i % 2 == 0) {
+                    engine.cancel_order(order_id);
+                }
+            }
+        });
+    }
+    for (std::thread& submitter : submitters) {
+        submitter.join();
+    }
+    int total = 0;
+    for (SymbolId symbol : ids) {
+        total += resting_quantity(engine, symbol);
+    }
+    CHECK(total == 4 * kOrders / 2);
+
+    // One crossing sell per symbol clears what rests there
+    for (SymbolId symbol : ids) {
+        engine.submit_order(symbol, to_ticks(90.0), 1000, false, OrderType::ImmediateOrCancel);
+        CHECK(resting_quantity(engine, symbol) == 0);
+    }
+    CHECK(eventually([&] { return engine.get_position(kDefaultAccount, ids[0]) == 0; }));
+}
+
+TEST_CASE(async_submits_are_applied_in_order) {
+    EngineConfig config;
+    config.matching_threads = 2;
+    ExecutionEngine engine(config);
+    SymbolId symbol = engine.register_symbol("XYZ");
+    std::vector<OrderId> order_ids;
+    for (int i = 0; i < 1000; ++i) {
+        OrderId order_id = engine.submit_order_async(symbol, to_ticks(100.0), 1, false);
+        CHECK(order_id != 0);
+        order_ids.push_back(order_id);
+    }
+    CHECK(engine.submit_order_async(SymbolId{99}, to_ticks(100.0), 1, false) == 0);
+
+    // A synchronous command queues behind them on the same ring
+    std::vector<std::string> passive;
+    engine.subscribe_trades("XYZ", [&](const Trade& trade) { passive.push_back(trade.passive_order_id); });
+    engine.submit_order(symbol, to_ticks(100.0), 3, true);
+    CHECK((passive == std::vector<std::string>{order_id_to_string(order_ids[0]), order_id_to_string(order_ids[1]),
+                                               order_id_to_string(order_ids[2])}));
+    CHECK(engine.get_top_of_book(symbol).ask_quantity == 997);
+}
+
+TEST_CASE(every_fill_prints_a_trade) {
+    ExecutionEngine engine;
+    SymbolId symbol = engine.register_symbol("XYZ");
+    std::vector<Trade> trades;
+    engine.subscribe_trades("XYZ", [&](const Trade& trade) { trades.push_back(trade); });
+    OrderId first = engine.submit_order(symbol, to_ticks(100.0), 2, false);
+    OrderId second = engine.submit_order(symbol, to_ticks(100.0), 2, false);
+    OrderId third = engine.submit_order(symbol, to_ticks(101.0), 2, false);
+    Timestamp before = wall_clock_ns();
+    OrderId taker = engine.submit_order(symbol, to_ticks(101.0), 5, true);
+
+    CHECK(trades.size() == 3);
+    if (trades.size() == 3) {
+        CHECK(trades[0].passive_order_id == order_id_to_string(first));
+        CHECK(trades[1].passive_order_id == order_id_to_string(second));
+        CHECK(trades[2].passive_order_id == order_id_to_string(third));
+        CHECK(trades[2].price == 101.0);
+        CHECK(trades[2].quantity == 1);
+        for (std::size_t i = 0; i < trades.size(); ++i) {
+            CHECK(trades[i].order_id == order_id_to_string(taker));
+            CHECK(trades[i].symbol == "XYZ");
+            CHECK(trades[i].aggressor_is_buy);
+            CHECK(trades[i].sequence == i + 1);
+            // One clock read per command
+            CHECK(trades[i].timestamp == trades[0].timestamp);
+        }
+        CHECK(trades[0].timestamp >= before);
+    }
+
+    engine.unsubscribe_trades("XYZ");
+    engine.submit_order(symbol, to_ticks(101.0), 1, true);
+    CHECK(trades.size() == 3);
+}
+
+TEST_CASE(callbacks_may_call_back_into_the_engine) {
+    for (std::size_t dispatch_threads : {std::size_t{0}, std::size_t{2}}) {
+        EngineConfig config;
+        config.dispatch_threads = dispatch_threads;
+        ExecutionEngine engine(config);
+        SymbolId a = engine.register_symbol("AAA");
+        SymbolId b = engine.register_symbol("BBB");
+        std::atomic<int> delivered{0};
+        std::mutex order_mutex;
+        std::map<SymbolId, std::vector<Timestamp>> order;
+        for (SymbolId symbol : {a, b}) {
+            engine.subscribe_market_data(symbol == a ? "AAA" : "BBB", [&, symbol](const MarketData& data) {
+                // Takes engine_mutex, so delivery must not hold it
+                engine.subscribe_market_data("CCC", [](const MarketData&) {});
+                std::lock_guard<std::mutex> lock(order_mutex);
+                order[symbol].push_back(data.timestamp);
+                delivered.fetch_add(1);
+            });
+        }
+        auto source = std::make_shared<CountedSource>(std::vector<SymbolId>{a, b}, 500);
+        engine.set_market_data_source(source);
+        engine.start();
+        CHECK(eventually([&] { return delivered.load() == 1000; }));
+        engine.stop();
+
+        std::lock_guard<std::mutex> lock(order_mutex);
+        for (SymbolId symbol : {a, b}) {
+            bool in_order = order[symbol].size() == 500;
+            for (std::size_t i = 0; in_order && i < order[symbol].size(); ++i) {
+                in_order = order[symbol][i] == static_cast<Timestamp>(i);
+            }
+            CHECK(in_order);
+        }
+    }
+}
+
+TEST_CASE(unsubscribing_stops_delivery) {
+    EngineConfig config;
+    config.dispatch_threads = 0;
+    ExecutionEngine engine(config);
+    SymbolId symbol = engine.register_symbol("XYZ");
+    int delivered = 0;
+    engine.subscribe_market_data("XYZ", [&](const MarketData&) { ++delivered; });
+    engine.unsubscribe_market_data("XYZ");
+    auto source = std::make_shared<CountedSource>(std::vector<SymbolId>{symbol}, 100);
+    engine.set_market_data_source(source);
+    engine.start();
+    CHECK(eventually([&] { return source->done.load(std::memory_order_acquire); }));
+    engine.stop();
+    CHECK(delivered == 0);
+}
+
+TEST_CASE(ticks_for_unregistered_ids_are_dropped) {
+    for (std::size_t dispatch_threads : {std::size_t{0}, std::size_t{2}}) {
+        EngineConfig config;
+        config.dispatch_threads = dispatch_threads;
+        ExecutionEngine engine(config);
+        SymbolId symbol = engine.register_symbol("XYZ");
+        std::atomic<int> delivered{0};
+        engine.subscribe_market_data("XYZ", [&](const MarketData&) { delivered.fetch_add(1); });
+        std::vector<SymbolId> ids{SymbolId{999}, symbol, kInvalidSymbol};
+        auto source = std::make_shared<CountedSource>(ids, 100);
+        engine.set_market_data_source(source);
+        engine.start();
+        CHECK(eventually([&] { return source->done.load(std::memory_order_acquire) && delivered.load() == 100; }));
+        engine.stop();
+        CHECK(delivered.load() == 100);
+    }
+}
+
+TEST_CASE(simulated_symbols_tick_at_their_own_rates) {
+    ExecutionEngine engine;
+    std::atomic<int> fast{0};
+    std::atomic<int> paused{0};
+    std::atomic<bool> monotonic{true};
+    Timestamp last = 0;
+    engine.subscribe_market_data("FAST", [&](const MarketData& data) {
+        if (data.monotonic_timestamp < last) {
+            monotonic = false;
+        }
+        last = data.monotonic_timestamp;
+        fast.fetch_add(1);
+    });
+    engine.subscribe_market_data("PAUSED", [&](const MarketData&) { paused.fetch_add(1); });
+    engine.set_market_data_rate("FAST", 200.0);
+    engine.set_market_data_rate("PAUSED", 0.0);
+    engine.start();
+    std::this_thread::sleep_for(std::chrono::milliseconds(300));
+    engine.stop();
+
+    std::printf("200 ticks/s for 300 ms delivered %d\n", fast.load());
+    CHECK(fast.load() >= 30);
+    CHECK(fast.load() <= 120);
+    CHECK(paused.load() == 0);
+    CHECK(monotonic.load());
+}
+
+TEST_CASE(timestamps_are_integer_nanoseconds) {
+    Timestamp wall = wall_clock_ns();
+    // Some time after 2020 and before 2100
+    CHECK(wall > 1577836800LL * 1000000000LL);
+    CHECK(wall < 4102444800LL * 1000000000LL);
+
+    Timestamp previous = tsc_clock_ns();
+    bool monotonic = true;
+    for (int i = 0; i < 10000; ++i) {
+        Timestamp now = tsc_clock_ns();
+        monotonic = monotonic && now >= previous;
+        previous = now;
+    }
+    CHECK(monotonic);
+    // Calibrated against steady_clock, so the two stay close
+    Timestamp drift = tsc_clock_ns() - steady_clock_ns();
+    CHECK(drift > -50000000 && drift < 50000000);
+    Timestamp steady = steady_clock_ns();
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    Timestamp slept = steady_clock_ns() - steady;
+    CHECK(slept >= 20000000);
+
+    std::string text = format_timestamp(1700000000123456789);
+    CHECK(text.size() == 29);
+    CHECK(text.substr(19) == ".123456789");
+    CHECK(format_timestamp(1700000000000000001).substr(19) == ".000000001");
+}
+
+TEST_MAIN
@@ -0,0 +1,430 @@
+#include "execution_engine.hpp"
+#include <atomic>
+#include <map>
+#include <random>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "test_support.hpp"
+
+using namespace trading;
+
+namespace {
+
+// Displayed size per price, as a feed consumer would rebuild it
+struct Levels {
+    std::map<Price, int> bids;
+    std::map<Price, int> asks;
+
+    bool operator==(const Levels&) const = default;
+};
+
+Levels levels_of(const DepthSnapshot& snapshot) {
+    Levels levels;
+    for (const DepthLevel& level : snapshot.bids) {
+        levels.bids[level.price] = level.quantity;
+    }
+    for (const DepthLevel& level : snapshot.asks) {
+        levels.asks[level.price] = level.quantity;
+    }
+    return levels;
+}
+
+// Applies one depth update; false if it does not fit the levels it is
+// applied to (an Add for a level that exists, or a Change or Delete for
+// one that does not)
+bool apply(Levels& levels, const DepthUpdate& update) {
+    std::map<Price, int>& side = update.is_buy ? levels.bids : levels.asks;
+    bool exists = side.count(update.price) != 0;
+    switch (update.action) {
+        case DepthUpdate::Action::Add:
+            side[update.price] = update.quantity;
+            return !exists && update.quantity > 0;
+        case DepthUpdate::Action::Change:
+            side[update.price] = update.quantity;
+            return exists && update.quantity > 0;
+        case DepthUpdate::Action::Delete:
+            side.erase(update.price);
+            return exists;
+    }
+    return false;
+}
+
+// Resting orders rebuilt from L3 events
+struct L3Book {
+    struct Resting {
+        Price price;
+        int quantity;
+        bool is_buy;
+    };
+    std::unordered_map<OrderId, Resting> orders;
+
+    void apply(const L3Event& event) {
+        switch (event.type) {
+            case L3Event::Type::Add:
+                orders[event.order_id] = Resting{event.price, event.remaining_quantity, event.is_buy};
+                break;
+            case L3Event::Type::Execute:
+            case L3Event::Type::Cancel:
+                if (event.remaining_quantity == 0) {
+                    orders.erase(event.order_id);
+                } else {
+                    orders[event.order_id].quantity = event.remaining_quantity;
+                }
+                break;
+            case L3Event::Type::Replace:
+                orders.erase(event.order_id);
+                break;
+        }
+    }
+
+    // Starts from a saved book, for a reader that joins late
+    void load(const BookState& state) {
+        orders.clear();
+        for (const BookState::Resting& resting : state.orders) {
+            const BookOrder& order = resting.order;
+            orders[order.order_id] = Resting{order.price, order.quantity, order.is_buy};
+        }
+    }
+
+    Levels levels() const {
+        Levels levels;
+        for (const auto& [order_id, resting] : orders) {
+            (resting.is_buy ? levels.bids : levels.asks)[resting.price] += resting.quantity;
+        }
+        return levels;
+    }
+};
+
+// A random command of every kind the book takes, around a price of 100
+class RandomCommands {
+public:
+    explicit RandomCommands(unsigned seed) : random_(seed) {}
+
+    void next(OrderBook& book, std::vector<DepthUpdate>& depth) {
+        Price price = to_ticks(100.0) + static_cast<Price>(pick(21)) * 100 - 1000;
+        int quantity = 1 + pick(20);
+        bool is_buy = pick(2) == 0;
+        int kind = pick(100);
+        if (kind < 15 && !live_.empty()) {
+            book.cancel(live_[pick(live_.size())], &depth);
+        } else if (kind < 30 && !live_.empty()) {
+            OrderId order_id = live_[pick(live_.size())];
+            book.modify(order_id, pick(2) == 0 ? price : to_ticks(100.0), pick(25), nullptr, &depth);
+        } else if (kind < 31) {
+            book.cancel_all(&depth);
+            live_.clear();
+        } else {
+            BookOrder order{++next_id_, price, quantity, is_buy};
+            if (kind < 40) {
+                order.type = OrderType::Market;
+            } else if (kind < 45) {
+                order.type = OrderType::ImmediateOrCancel;
+            } else if (kind < 50) {
+                order.type = OrderType::FillOrKill;
+            } else if (kind < 55) {
+                order.type = OrderType::PostOnly;
+            } else if (kind < 58) {
+                order.type = pick(2) == 0 ? OrderType::Stop : OrderType::StopLimit;
+                order.stop_price = price;
+            } else if (kind < 65) {
+                order.display_quantity = 1 + pick(5);
+                order.quantity += 20;
+            }
+            if (book.add_order(order, nullptr, &depth)) {
+                live_.push_back(order.order_id);
+            }
+        }
+        // Forget ids now and then so the list tracks roughly what rests
+        if (live_.size() > 400) {
+            live_.erase(live_.begin(), live_.begin() + 200);
+        }
+    }
+
+private:
+    int pick(std::size_t count) { return static_cast<int>(random_() % count); }
+
+    std::mt19937_64 random_;
+    std::vector<OrderId> live_;
+    OrderId next_id_ = 0;
+};
+
+} // anonymous namespace
+
+TEST_CASE(depth_updates_rebuild_the_book_over_a_random_mix) {
+    OrderBook book("XYZ");
+    RandomCommands commands(19);
+    Levels replica;
+    Levels from_snapshot;
+    std::uint64_t snapshot_sequence = 0;
+    std::uint64_t expected = 1;
+    int misfits = 0;
+    int mismatches = 0;
+    std::vector<DepthUpdate> depth;
+    DepthSnapshot snapshot;
+
+    for (int i = 0; i < 200000; ++i) {
+        depth.clear();
+        commands.next(book, depth);
+        for (const DepthUpdate& update : depth) {
+            if (update.sequence != expected++) {
+                ++misfits;
+            }
+            misfits += apply(replica, update) ? 0 : 1;
+            if (update.sequence > snapshot_sequence) {
+                apply(from_snapshot, update);
+            }
+        }
+        if (i % 1000 == 0) {
+            book.get_depth(1000, snapshot);
+            mismatches += levels_of(snapshot) == replica ? 0 : 1;
+            CHECK(snapshot.sequence == expected - 1);
+        }
+        if (i == 100000) {
+            // A late joiner starts from a snapshot and applies what follows
+            book.get_depth(1000, snapshot);
+            from_snapshot = levels_of(snapshot);
+            snapshot_sequence = snapshot.sequence;
+        }
+    }
+    book.get_depth(1000, snapshot);
+    CHECK(misfits == 0);
+    CHECK(mismatches == 0);
+    CHECK(levels_of(snapshot) == replica);
+    CHECK(from_snapshot == replica);
+    // Most commands move some level, so the run covers plenty of updates
+    CHECK(expected > 100000);
+}
+
+TEST_CASE(a_sweep_reports_each_level_once) {
+    OrderBook book("XYZ");
+    for (OrderId id = 1; id <= 6; ++id) {
+        book.add_order(BookOrder{id, to_ticks(100.0) + static_cast<Price>(id % 3) * 100, 5, false});
+    }
+    std::vector<DepthUpdate> depth;
+    book.add_order(BookOrder{10, to_ticks(100.01), 12, true}, nullptr, &depth);
+    CHECK(depth.size() == 2);
+    CHECK(depth[0].action == DepthUpdate::Action::Delete);
+    CHECK(depth[0].price == to_ticks(100.0));
+    CHECK(depth[1].action == DepthUpdate::Action::Change);
+    CHECK(depth[1].price == to_ticks(100.01));
+    CHECK(depth[1].quantity == 8);
+
+    // A re-price leaves one level and opens another
+    depth.clear();
+    book.add_order(BookOrder{11, to_ticks(99.0), 5, false}, nullptr, nullptr);
+    book.modify(11, to_ticks(99.5), 5, nullptr, &depth);
+    CHECK(depth.size() == 2);
+    CHECK(depth[0].action == DepthUpdate::Action::Delete);
+    CHECK(depth[1].action == DepthUpdate::Action::Add);
+}
+
+TEST_CASE(l3_events_are_gapless_and_rebuild_the_book) {
+    OrderBook book("XYZ", 7);
+    auto ring = book.open_l3_feed(1 << 12);
+    L3Reader reader(ring);
+    RandomCommands commands(20);
+    L3Book replica;
+    SequenceGapDetector gaps;
+    std::uint64_t events = 0;
+    int wrong_symbol = 0;
+    int mismatches = 0;
+    std::vector<DepthUpdate> depth;
+    DepthSnapshot snapshot;
+
+    for (int i = 0; i < 50000; ++i) {
+        depth.clear();
+        commands.next(book, depth);
+        L3Event event;
+        L3Reader::Status status;
+        while ((status = reader.poll(event)) == L3Reader::Status::Ok) {
+            gaps.observe(event.sequence);
+            wrong_symbol += event.symbol == 7 ? 0 : 1;
+            replica.apply(event);
+            ++events;
+        }
+        CHECK(status == L3Reader::Status::Empty);
+        if (i % 500 == 0) {
+            book.get_depth(1000, snapshot);
+            mismatches += levels_of(snapshot) == replica.levels() ? 0 : 1;
+        }
+    }
+    book.get_depth(1000, snapshot);
+    CHECK(levels_of(snapshot) == replica.levels());
+    CHECK(mismatches == 0);
+    CHECK(gaps.missed() == 0);
+    CHECK(gaps.expected() == events + 1);
+    CHECK(reader.missed() == 0);
+    CHECK(wrong_symbol == 0);
+}
+
+TEST_CASE(a_late_l3_reader_joins_from_a_saved_book) {
+    // Two books take the same commands; one feed is open from the start and
+    // the other only halfway through
+    OrderBook early("XYZ", 0);
+    OrderBook late("XYZ", 0);
+    L3Reader early_reader(early.open_l3_feed(1 << 16));
+    L3Reader late_reader;
+    RandomCommands early_commands(21);
+    RandomCommands late_commands(21);
+    L3Book replica;
+    BookState state;
+    std::vector<std::uint64_t> early_sequences;
+    std::vector<std::uint64_t> late_sequences;
+    std::vector<DepthUpdate> depth;
+    L3Event event;
+
+    for (int i = 0; i < 20000; ++i) {
+        if (i == 10000) {
+            late.save(state);
+            replica.load(state);
+            late_reader = L3Reader(late.open_l3_feed(1 << 16));
+            early_sequences.clear();
+        }
+        depth.clear();
+        early_commands.next(early, depth);
+        depth.clear();
+        late_commands.next(late, depth);
+        while (early_reader.poll(event) == L3Reader::Status::Ok) {
+            early_sequences.push_back(event.sequence);
+        }
+        while (late_reader.poll(event) == L3Reader::Status::Ok) {
+            late_sequences.push_back(event.sequence);
+            replica.apply(event);
+        }
+    }
+    CHECK(state.l3_sequence > 0);
+    CHECK(!late_sequences.empty() && late_sequences.front() == state.l3_sequence + 1);
+    CHECK(late_sequences == early_sequences);
+    DepthSnapshot snapshot;
+    late.get_depth(1000, snapshot);
+    CHECK(levels_of(snapshot) == replica.levels());
+}
+
+TEST_CASE(l3_events_describe_each_step) {
+    OrderBook book("XYZ", 0);
+    L3Reader reader(book.open_l3_feed(64));
+    book.add_order(BookOrder{1, to_ticks(100.0), 10, false, OrderType::Limit, 4}, nullptr, nullptr, 1000);
+    book.add_order(BookOrder{2, to_ticks(100.0), 6, true}, nullptr, nullptr, 2000);
+
+    std::vector<L3Event> events;
+    L3Event event;
+    while (reader.poll(event) == L3Reader::Status::Ok) {
+        events.push_back(event);
+    }
+    // The refill of the iceberg is an Add of its own, behind the execute
+    // that emptied the display
+    CHECK(events.size() == 4);
+    if (events.size() == 4) {
+        CHECK(events[0].type == L3Event::Type::Add && events[0].quantity == 4);
+        CHECK(events[0].timestamp == 1000);
+        CHECK(events[1].type == L3Event::Type::Execute && events[1].other_order_id == 2);
+        CHECK(events[1].remaining_quantity == 0);
+        CHECK(events[1].timestamp == 2000);
+        CHECK(events[2].type == L3Event::Type::Add && events[2].order_id == 1);
+        CHECK(events[3].type == L3Event::Type::Execute && events[3].quantity == 2);
+        CHECK(events[3].remaining_quantity == 2);
+        for (std::size_t i = 0; i < events.size(); ++i) {
+            CHECK(events[i].sequence == i + 1);
+        }
+    }
+}
+
+TEST_CASE(a_lapped_l3_reader_reports_one_gap_then_resumes) {
+    OrderBook book("XYZ", 0);
+    L3Reader reader(book.open_l3_feed(16));
+    for (OrderId id = 1; id <= 100; ++id) {
+        book.add_order(BookOrder{id, to_ticks(100.0), 1, true});
+    }
+
+    L3Event event;
+    CHECK(reader.poll(event) == L3Reader::Status::Gap);
+    CHECK(reader.missed() == 84);
+    std::uint64_t expected = 85;
+    int out_of_order = 0;
+    while (reader.poll(event) == L3Reader::Status::Ok) {
+        out_of_order += event.sequence == expected++ ? 0 : 1;
+    }
+    CHECK(out_of_order == 0);
+    CHECK(expected == 101);
+    CHECK(reader.poll(event) == L3Reader::Status::Empty);
+    CHECK(reader.missed() == 84);
+}
+
+TEST_CASE(a_reader_racing_the_writer_never_reports_a_false_gap) {
+    OrderBook book("XYZ", 0);
+    L3Reader reader(book.open_l3_feed(1 << 16));
+    std::atomic<bool> done{false};
+    std::thread writer([&] {
+        for (OrderId id = 1; id <= 20000; ++id) {
+            book.add_order(BookOrder{id, to_ticks(100.0), 1, true});
+        }
+        done.store(true);
+    });
+    std::uint64_t read = 0;
+    int gaps = 0;
+    L3Event event;
+    while (true) {
+        L3Reader::Status status = reader.poll(event);
+        if (status == L3Reader::Status::Ok) {
+            ++read;
+        } else if (status == L3Reader::Status::Gap) {
+            ++gaps;
+        } else if (done.load()) {
+            if (reader.poll(event) != L3Reader::Status::Ok) {
+                break;
+            }
+            ++read;
+        }
+    }
+    writer.join();
+    CHECK(gaps == 0);
+    CHECK(read == 20000);
+}
+
+TEST_CASE(sequence_gap_detector_counts_holes_not_duplicates) {
+    SequenceGapDetector detector;
+    CHECK(detector.observe(1) == 0);
+    CHECK(detector.observe(2) == 0);
+    CHECK(detector.observe(5) == 2);
+    CHECK(detector.observe(3) == 0);
+    CHECK(detector.observe(5) == 0);
+    CHECK(detector.observe(6) == 0);
+    CHECK(detector.missed() == 2);
+    CHECK(detector.expected() == 7);
+}
+
+TEST_CASE(engine_feeds_depth_and_l3_per_symbol) {
+    ExecutionEngine engine;
+    SymbolId symbol = engine.register_symbol("XYZ");
+    std::vector<DepthUpdate> received;
+    engine.subscribe_depth("XYZ", [&](const DepthUpdate& update) { received.push_back(update); });
+    L3Reader reader = engine.open_l3_feed(symbol);
+    CHECK(reader.attached());
+    CHECK(!engine.open_l3_feed("missing").attached());
+
+    engine.submit_order(symbol, to_ticks(100.0), 5, true);
+    engine.submit_order(symbol, to_ticks(100.0), 3, true);
+    engine.submit_order(symbol, to_ticks(100.0), 8, false);
+    CHECK(received.size() == 3);
+    if (received.size() == 3) {
+        CHECK(received[0].action == DepthUpdate::Action::Add);
+        CHECK(received[1].action == DepthUpdate::Action::Change && received[1].quantity == 8);
+        CHECK(received[2].action == DepthUpdate::Action::Delete);
+        CHECK(received[2].sequence == 3);
+    }
+    DepthSnapshot snapshot = engine.get_depth("XYZ", 10);
+    CHECK(snapshot.bids.empty() && snapshot.asks.empty());
+    CHECK(snapshot.sequence == 3);
+
+    L3Event event;
+    int events = 0;
+    while (reader.poll(event) == L3Reader::Status::Ok) {
+        CHECK(event.symbol == symbol);
+        ++events;
+    }
+    CHECK(events == 4);
+}
+
+TEST_MAIN
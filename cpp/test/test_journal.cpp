@@ -0,0 +1,608 @@
+#include "execution_engine.hpp"
+#include "journal.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <random>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+#include "test_support.hpp"
+
+using namespace trading;
+
+namespace {
+
+EngineConfig journal_config(const std::string& directory) {
+    EngineConfig config;
+    config.journal_directory = directory;
+    config.journal_segment_bytes = std::size_t{1} << 20;
+    return config;
+}
+
+std::vector<Price> bid_prices(ExecutionEngine& engine, const std::string& symbol) {
+    std::vector<Price> prices;
+    for (const DepthLevel& level : engine.get_depth(symbol, 100).bids) {
+        prices.push_back(level.price);
+    }
+    return prices;
+}
+
+void overwrite(const std::string& path, long offset, const char* bytes, std::size_t size) {
+    FILE* file = std::fopen(path.c_str(), "r+b");
+    CHECK(file != nullptr);
+    if (file != nullptr) {
+        std::fseek(file, offset, SEEK_SET);
+        std::fwrite(bytes, 1, size, file);
+        std::fclose(file);
+    }
+}
+
+const std::vector<std::string> kSymbols{"AAA", "BBB", "CCC"};
+constexpr AccountId kAccounts = 3;
+
+// Drives several engines with the same random commands, so an engine that
+// was recovered can be held up against one that never stopped. Ids are
+// handed out the same way in each, so the commands line up.
+class Lockstep {
+public:
+    explicit Lockstep(unsigned seed) : random_(seed) {}
+
+    void run(const std::vector<ExecutionEngine*>& engines, int commands) {
+        for (int i = 0; i < commands; ++i) {
+            step(engines);
+        }
+    }
+
+private:
+    int pick(std::size_t count) { return static_cast<int>(random_() % count); }
+
+    void step(const std::vector<ExecutionEngine*>& engines) {
+        SymbolId symbol = static_cast<SymbolId>(pick(kSymbols.size()));
+        Price price = to_ticks(100.0) + static_cast<Price>(pick(11)) * 100 - 500;
+        int quantity = 1 + pick(10);
+        bool is_buy = pick(2) == 0;
+        AccountId account = static_cast<AccountId>(pick(kAccounts));
+        int kind = pick(100);
+
+        OrderId order_id = 0;
+        if (kind < 15 && !live_.empty()) {
+            OrderId target = live_[pick(live_.size())];
+            for (ExecutionEngine* engine : engines) {
+                engine->cancel_order(target);
+            }
+        } else if (kind < 30 && !live_.empty()) {
+            OrderId target = live_[pick(live_.size())];
+            int new_quantity = pick(12);
+            for (ExecutionEngine* engine : engines) {
+                engine->modify_order(target, price, new_quantity);
+            }
+        } else if (kind < 31) {
+            for (ExecutionEngine* engine : engines) {
+                engine->cancel_all_orders(kSymbols[symbol]);
+            }
+        } else if (kind < 40) {
+            int display = 1 + pick(3);
+            for (ExecutionEngine* engine : engines) {
+                order_id = engine->submit_iceberg_order(symbol, price, quantity + 10, is_buy, display, account);
+            }
+        } else if (kind < 45) {
+            OrderType type = pick(2) == 0 ? OrderType::Stop : OrderType::StopLimit;
+            for (ExecutionEngine* engine : engines) {
+                order_id = engine->submit_stop_order(symbol, price, quantity, is_buy, type, price, account);
+            }
+        } else {
+            OrderType type = kind < 50 ? OrderType::Market : kind < 55 ? OrderType::FillOrKill : OrderType::Limit;
+            for (ExecutionEngine* engine : engines) {
+                order_id = engine->submit_order(symbol, price, quantity, is_buy, type, account);
+            }
+        }
+        if (order_id != 0) {
+            live_.push_back(order_id);
+            if (live_.size() > 300) {
+                live_.erase(live_.begin(), live_.begin() + 150);
+            }
+        }
+    }
+
+    std::mt19937_64 random_;
+    std::vector<OrderId> live_;
+};
+
+std::vector<ExecutionEngine*> engines(ExecutionEngine& a, ExecutionEngine& b) {
+    for (const std::string& symbol : kSymbols) {
+        a.register_symbol(symbol);
+        b.register_symbol(symbol);
+    }
+    return {&a, &b};
+}
+
+bool same_books(const ExecutionEngine& a, const ExecutionEngine& b) {
+    for (SymbolId symbol = 0; symbol < kSymbols.size(); ++symbol) {
+        DepthSnapshot left;
+        DepthSnapshot right;
+        a.get_depth(symbol, 1000, left);
+        b.get_depth(symbol, 1000, right);
+        auto same_levels = [](const std::vector<DepthLevel>& x, const std::vector<DepthLevel>& y) {
+            return std::equal(x.begin(), x.end(), y.begin(), y.end(), [](const DepthLevel& p, const DepthLevel& q) {
+                return p.price == q.price && p.quantity == q.quantity;
+            });
+        };
+        if (!same_levels(left.bids, right.bids) || !same_levels(left.asks, right.asks) ||
+            left.sequence != right.sequence || !(a.get_top_of_book(symbol) == b.get_top_of_book(symbol))) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Positions are booked by the accounting thread, so this waits for both
+// engines to settle on the same ones
+bool same_positions(const ExecutionEngine& a, const ExecutionEngine& b) {
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+    while (true) {
+        bool same = true;
+        for (AccountId account = 0; account < kAccounts; ++account) {
+            for (SymbolId symbol = 0; symbol < kSymbols.size(); ++symbol) {
+                Position left = a.get_position_snapshot(account, symbol);
+                Position right = b.get_position_snapshot(account, symbol);
+                same = same && left.quantity == right.quantity && left.average_price == right.average_price &&
+                       left.realized_pnl == right.realized_pnl;
+            }
+        }
+        if (same) {
+            return true;
+        }
+        if (std::chrono::steady_clock::now() > deadline) {
+            return false;
+        }
+        std::this_thread::yield();
+    }
+}
+
+} // anonymous namespace
+
+TEST_CASE(damaged_segment_is_set_aside_so_later_commands_survive) {
+    test::ScratchDirectory directory("journal-damaged");
+    EngineConfig config = journal_config(directory.path());
+    {
+        ExecutionEngine engine(config);
+        engine.submit_order("XYZ", to_ticks(100.0), 1, true);
+        // Enough entries to roll into segment 1
+        for (int i = 0; i < 8000; ++i) {
+            engine.cancel_order(engine.submit_order("XYZ", to_ticks(200.0), 1, false));
+        }
+    }
+    {
+        ExecutionEngine engine(config);
+        engine.submit_order("XYZ", to_ticks(101.0), 1, true);
+    }
+    CHECK(std::filesystem::exists(journal_segment_path(directory.path(), 1)));
+    overwrite(journal_segment_path(directory.path(), 1), 0, "BROKEN!!", 8);
+    {
+        ExecutionEngine engine(config);
+        CHECK(engine.recovery_stats().damaged);
+        CHECK(bid_prices(engine, "XYZ") == std::vector<Price>{to_ticks(100.0)});
+        engine.submit_order("XYZ", to_ticks(102.0), 1, true);
+    }
+    CHECK(std::filesystem::exists(journal_segment_path(directory.path(), 1) + ".damaged"));
+    {
+        ExecutionEngine engine(config);
+        CHECK(!engine.recovery_stats().damaged);
+        CHECK(bid_prices(engine, "XYZ") == (std::vector<Price>{to_ticks(102.0), to_ticks(100.0)}));
+    }
+}
+
+TEST_CASE(reopening_continues_the_tail_segment_and_trims_it) {
+    test::ScratchDirectory directory("journal-reopen");
+    EngineConfig config = journal_config(directory.path());
+    std::string segment = journal_segment_path(directory.path(), 0);
+    for (int run = 0; run < 3; ++run) {
+        ExecutionEngine engine(config);
+        engine.submit_order("XYZ", to_ticks(100.0 + run), 1, true);
+    }
+    for (int run = 0; run < 3; ++run) {
+        ExecutionEngine engine(config);
+    }
+
+    CHECK(!std::filesystem::exists(journal_segment_path(directory.path(), 1)));
+    // Header, the registration and three orders, with no preallocated slack
+    std::uintmax_t entries = 4 * (sizeof(JournalEntryHeader) + sizeof(JournalRecord)) + std::string("XYZ").size();
+    CHECK(std::filesystem::file_size(segment) == sizeof(JournalSegmentHeader) + entries);
+
+    ExecutionEngine engine(config);
+    CHECK(engine.recovery_stats().replayed == 4);
+    CHECK(bid_prices(engine, "XYZ") == (std::vector<Price>{to_ticks(102.0), to_ticks(101.0), to_ticks(100.0)}));
+}
+
+TEST_CASE(a_torn_tail_is_cut_before_the_segment_is_continued) {
+    test::ScratchDirectory directory("journal-torn");
+    EngineConfig config = journal_config(directory.path());
+    std::string segment = journal_segment_path(directory.path(), 0);
+    {
+        ExecutionEngine engine(config);
+        engine.submit_order("XYZ", to_ticks(100.0), 1, true);
+        engine.submit_order("XYZ", to_ticks(101.0), 1, true);
+        engine.submit_order("XYZ", to_ticks(102.0), 1, true);
+    }
+    // Tear the second order; the third is intact but no longer follows on
+    long second = static_cast<long>(std::filesystem::file_size(segment) -
+                                    2 * (sizeof(JournalEntryHeader) + sizeof(JournalRecord)));
+    overwrite(segment, second + 20, "\x5a", 1);
+    {
+        ExecutionEngine engine(config);
+        CHECK(bid_prices(engine, "XYZ") == std::vector<Price>{to_ticks(100.0)});
+        engine.submit_order("XYZ", to_ticks(103.0), 1, true);
+    }
+    ExecutionEngine engine(config);
+    CHECK(!engine.recovery_stats().damaged);
+    CHECK(bid_prices(engine, "XYZ") == (std::vector<Price>{to_ticks(103.0), to_ticks(100.0)}));
+}
+
+TEST_CASE(snapshots_prune_segments_older_than_both_kept_snapshots) {
+    test::ScratchDirectory directory("journal-prune");
+    EngineConfig config = journal_config(directory.path());
+    config.snapshots = true;
+    // About 14k entries fit in a 1 MiB segment
+    auto churn = [](ExecutionEngine& engine, int orders) {
+        for (int i = 0; i < orders; ++i) {
+            engine.cancel_order(engine.submit_order("XYZ", to_ticks(200.0), 1, false));
+        }
+    };
+    {
+        ExecutionEngine engine(config);
+        engine.submit_order("XYZ", to_ticks(100.0), 1, true);
+        churn(engine, 20000);
+        std::uint64_t first = engine.snapshot();
+        CHECK(first != 0);
+        CHECK(std::filesystem::exists(journal_segment_path(directory.path(), 0)));
+        churn(engine, 20000);
+        CHECK(engine.snapshot() > first);
+        // Segment 0 ends before the older snapshot; the one it falls in stays
+        CHECK(!std::filesystem::exists(journal_segment_path(directory.path(), 0)));
+        CHECK(std::filesystem::exists(journal_segment_path(directory.path(), 2)));
+        engine.submit_order("XYZ", to_ticks(101.0), 1, true);
+    }
+    ExecutionEngine engine(config);
+    CHECK(!engine.recovery_stats().damaged);
+    CHECK(bid_prices(engine, "XYZ") == (std::vector<Price>{to_ticks(101.0), to_ticks(100.0)}));
+    CHECK(engine.get_depth("XYZ", 100).asks.empty());
+}
+
+TEST_CASE(a_pruned_journal_does_not_open_without_its_snapshots) {
+    test::ScratchDirectory directory("journal-pruned-no-snapshots");
+    EngineConfig config = journal_config(directory.path());
+    config.snapshots = true;
+    {
+        ExecutionEngine engine(config);
+        for (int round = 0; round < 2; ++round) {
+            for (int i = 0; i < 20000; ++i) {
+                engine.cancel_order(engine.submit_order("XYZ", to_ticks(200.0), 1, false));
+            }
+            engine.snapshot();
+        }
+    }
+    CHECK(!std::filesystem::exists(journal_segment_path(directory.path(), 0)));
+    config.snapshots = false;
+    bool threw = false;
+    try {
+        ExecutionEngine engine(config);
+    } catch (const std::system_error&) {
+        threw = true;
+    }
+    CHECK(threw);
+}
+
+TEST_CASE(journal_records_read_back_in_order) {
+    test::ScratchDirectory directory("journal-round-trip");
+    std::vector<std::uint64_t> tapped;
+    const std::string name = "XYZ";
+    {
+        // Enough records to span three of the smallest segments
+        Journal journal(directory.path(), 0, 1024, 1,
+                        [&](const JournalRecord& record, const std::string*) { tapped.push_back(record.sequence); });
+        CHECK(journal.append_symbol(0, name) == 1);
+        for (int i = 0; i < 30000; ++i) {
+            JournalRecord record{};
+            record.type = i % 3 == 0 ? JournalRecord::Type::Cancel : JournalRecord::Type::Submit;
+            record.timestamp = 1000 + i;
+            record.order_id = make_order_id(i + 1, 0);
+            record.price = to_ticks(100.0) + i;
+            record.quantity = i + 1;
+            record.display_quantity = i % 7;
+            record.account = static_cast<AccountId>(i % 4);
+            record.order_type = static_cast<OrderType>(i % 7);
+            record.is_buy = i % 2 == 0;
+            CHECK(journal.append(record) == static_cast<std::uint64_t>(i + 2));
+        }
+        CHECK(journal.appended_sequence() == 30001);
+        CHECK(journal.wait_durable(30001));
+        CHECK(journal.durable_sequence() == 30001);
+        CHECK(journal.error() == 0);
+    }
+    CHECK(tapped.size() == 30001);
+    CHECK(tapped.back() == 30001);
+    CHECK(std::filesystem::exists(journal_segment_path(directory.path(), 2)));
+
+    JournalReader reader(directory.path());
+    JournalRecord record;
+    std::string_view read_name;
+    CHECK(reader.next(record, read_name));
+    CHECK(record.type == JournalRecord::Type::RegisterSymbol);
+    CHECK(read_name == name);
+    int mismatches = 0;
+    for (int i = 0; i < 30000; ++i) {
+        if (!reader.next(record, read_name)) {
+            ++mismatches;
+            break;
+        }
+        bool same = record.sequence == static_cast<std::uint64_t>(i + 2) && record.timestamp == 1000 + i &&
+                    record.order_id == make_order_id(i + 1, 0) && record.price == to_ticks(100.0) + i &&
+                    record.quantity == i + 1 && record.display_quantity == i % 7 &&
+                    record.account == static_cast<AccountId>(i % 4) &&
+                    record.order_type == static_cast<OrderType>(i % 7) && record.is_buy == (i % 2 == 0);
+        mismatches += same ? 0 : 1;
+    }
+    CHECK(mismatches == 0);
+    CHECK(!reader.next(record, read_name));
+    CHECK(reader.last_sequence() == 30001);
+    CHECK(!reader.damaged());
+}
+
+TEST_CASE(a_missing_directory_reads_as_an_empty_journal) {
+    test::ScratchDirectory directory("journal-missing");
+    JournalReader reader(directory.path() + "/nothing-here");
+    JournalRecord record;
+    std::string_view name;
+    CHECK(!reader.next(record, name));
+    CHECK(!reader.damaged());
+}
+
+TEST_CASE(journal_sync_waits_for_the_disk) {
+    test::ScratchDirectory directory("journal-sync");
+    EngineConfig config = journal_config(directory.path());
+    config.journal_sync = true;
+    config.matching_threads = 1;
+    {
+        ExecutionEngine engine(config);
+        engine.submit_order("XYZ", to_ticks(100.0), 1, true);
+        CHECK(engine.journal_error() == 0);
+    }
+    JournalReader reader(directory.path());
+    JournalRecord record;
+    std::string_view name;
+    int records = 0;
+    while (reader.next(record, name)) {
+        ++records;
+    }
+    CHECK(records == 2);
+}
+
+std::vector<L3Reader> open_l3_feeds(ExecutionEngine& engine) {
+    std::vector<L3Reader> readers;
+    for (SymbolId symbol = 0; symbol < kSymbols.size(); ++symbol) {
+        readers.push_back(engine.open_l3_feed(symbol));
+    }
+    return readers;
+}
+
+// Sequence of the last L3 event each reader holds
+std::vector<std::uint64_t> last_l3_sequences(std::vector<L3Reader>& readers) {
+    std::vector<std::uint64_t> sequences;
+    for (L3Reader& reader : readers) {
+        std::uint64_t last = 0;
+        L3Event event;
+        L3Reader::Status status;
+        while ((status = reader.poll(event)) != L3Reader::Status::Empty) {
+            if (status == L3Reader::Status::Ok) {
+                last = event.sequence;
+            }
+        }
+        sequences.push_back(last);
+    }
+    return sequences;
+}
+
+// Rests and pulls one order far below the market on each symbol, returning
+// the sequence of the first L3 event that follows
+std::vector<std::uint64_t> next_l3_sequences(ExecutionEngine& engine) {
+    std::vector<L3Reader> readers = open_l3_feeds(engine);
+    for (SymbolId symbol = 0; symbol < kSymbols.size(); ++symbol) {
+        engine.cancel_order(engine.submit_order(symbol, to_ticks(1.0), 1, true));
+    }
+    std::vector<std::uint64_t> sequences;
+    for (L3Reader& reader : readers) {
+        L3Event event{};
+        sequences.push_back(reader.poll(event) == L3Reader::Status::Ok ? event.sequence : 0);
+    }
+    return sequences;
+}
+
+std::vector<std::uint64_t> plus_one(std::vector<std::uint64_t> sequences) {
+    for (std::uint64_t& sequence : sequences) {
+        ++sequence;
+    }
+    return sequences;
+}
+
+TEST_CASE(recovered_engine_matches_one_that_never_stopped) {
+    test::ScratchDirectory directory("journal-recover");
+    EngineConfig config = journal_config(directory.path());
+    config.matching_threads = 1;
+    ExecutionEngine reference;
+    Lockstep commands(22);
+    std::uint64_t journaled = 0;
+    std::vector<std::uint64_t> live_l3;
+    {
+        ExecutionEngine engine(config);
+        commands.run(engines(engine, reference), 10000);
+        // A feed opened part way through still counts from the start
+        std::vector<L3Reader> readers = open_l3_feeds(engine);
+        commands.run(engines(engine, reference), 10000);
+        CHECK(same_books(engine, reference));
+        live_l3 = last_l3_sequences(readers);
+    }
+    {
+        ExecutionEngine engine(config);
+        const RecoveryStats& stats = engine.recovery_stats();
+        CHECK(!stats.damaged);
+        CHECK(stats.snapshot_sequence == 0);
+        CHECK(stats.replayed == stats.last_sequence);
+        CHECK(stats.replayed > 20000);
+        journaled = stats.last_sequence;
+        CHECK(same_books(engine, reference));
+        CHECK(same_positions(engine, reference));
+        std::vector<std::uint64_t> recovered_l3 = next_l3_sequences(engine);
+        CHECK(recovered_l3 == plus_one(live_l3));
+        CHECK(recovered_l3 == next_l3_sequences(reference));
+
+        // Hidden iceberg size, pending stops and the id sequence only show
+        // once trading carries on
+        commands.run(engines(engine, reference), 5000);
+        CHECK(same_books(engine, reference));
+        CHECK(same_positions(engine, reference));
+    }
+    ExecutionEngine engine(config);
+    CHECK(engine.recovery_stats().last_sequence > journaled);
+    CHECK(same_books(engine, reference));
+    CHECK(same_positions(engine, reference));
+}
+
+TEST_CASE(recovery_keeps_trade_sequences_going) {
+    test::ScratchDirectory directory("journal-trade-sequence");
+    EngineConfig config = journal_config(directory.path());
+    {
+        ExecutionEngine engine(config);
+        engine.submit_order("XYZ", to_ticks(100.0), 3, false);
+        engine.submit_order("XYZ", to_ticks(100.0), 1, true);
+        engine.submit_order("XYZ", to_ticks(100.0), 1, true);
+    }
+    ExecutionEngine engine(config);
+    std::vector<std::uint64_t> sequences;
+    engine.subscribe_trades("XYZ", [&](const Trade& trade) { sequences.push_back(trade.sequence); });
+    engine.submit_order("XYZ", to_ticks(100.0), 1, true);
+    CHECK(sequences == std::vector<std::uint64_t>{3});
+    CHECK(engine.get_position("XYZ") == 0);
+}
+
+TEST_CASE(recovery_timings) {
+    test::ScratchDirectory directory("journal-timings");
+    EngineConfig config = journal_config(directory.path());
+    {
+        ExecutionEngine engine(config);
+        SymbolId symbol = engine.register_symbol("XYZ");
+        engine.submit_order(symbol, to_ticks(100.0), 1, true);
+        for (int i = 0; i < 80000; ++i) {
+            engine.cancel_order(engine.submit_order(symbol, to_ticks(200.0), 1, false));
+        }
+    }
+
+    using Clock = std::chrono::steady_clock;
+    auto milliseconds = [](Clock::duration elapsed) {
+        return std::chrono::duration<double, std::milli>(elapsed).count();
+    };
+    Clock::time_point start = Clock::now();
+    JournalReader reader(directory.path());
+    JournalRecord record;
+    std::string_view name;
+    std::uint64_t records = 0;
+    while (reader.next(record, name)) {
+        ++records;
+    }
+    double scan = milliseconds(Clock::now() - start);
+
+    start = Clock::now();
+    ExecutionEngine engine(config);
+    double recover = milliseconds(Clock::now() - start);
+    std::printf("scanned %llu records in %.1f ms, recovered the engine in %.1f ms\n",
+                static_cast<unsigned long long>(records), scan, recover);
+
+    CHECK(records == 160002);
+    CHECK(engine.recovery_stats().replayed == records);
+    CHECK(bid_prices(engine, "XYZ") == std::vector<Price>{to_ticks(100.0)});
+    // Loose enough for an unoptimized build on a busy machine; an optimized
+    // one scans in a few milliseconds
+    CHECK(scan < 2000.0);
+    CHECK(recover < 20000.0);
+}
+
+TEST_CASE(recovery_loads_a_snapshot_and_replays_the_tail) {
+    test::ScratchDirectory directory("journal-snapshot-tail");
+    EngineConfig config = journal_config(directory.path());
+    config.snapshots = true;
+    config.matching_threads = 1;
+    ExecutionEngine reference;
+    Lockstep commands(23);
+    std::uint64_t snapshot_sequence = 0;
+    std::uint64_t last_sequence = 0;
+    std::vector<std::uint64_t> live_l3;
+    {
+        ExecutionEngine engine(config);
+        std::vector<ExecutionEngine*> both = engines(engine, reference);
+        std::vector<L3Reader> readers = open_l3_feeds(engine);
+        commands.run(both, 10000);
+        snapshot_sequence = engine.snapshot();
+        CHECK(snapshot_sequence > 10000);
+        commands.run(both, 3000);
+        live_l3 = last_l3_sequences(readers);
+    }
+    {
+        ExecutionEngine engine(config);
+        const RecoveryStats& stats = engine.recovery_stats();
+        CHECK(!stats.damaged);
+        CHECK(stats.snapshot_sequence == snapshot_sequence);
+        CHECK(stats.replayed == stats.last_sequence - snapshot_sequence);
+        CHECK(stats.replayed >= 3000);
+        last_sequence = stats.last_sequence;
+        CHECK(same_books(engine, reference));
+        CHECK(same_positions(engine, reference));
+        // The snapshot's replica books count L3 events too
+        std::vector<std::uint64_t> recovered_l3 = next_l3_sequences(engine);
+        CHECK(recovered_l3 == plus_one(live_l3));
+        CHECK(recovered_l3 == next_l3_sequences(reference));
+
+        commands.run(engines(engine, reference), 3000);
+        CHECK(same_books(engine, reference));
+        CHECK(same_positions(engine, reference));
+    }
+    // Without snapshots the whole journal is replayed to the same state
+    config.snapshots = false;
+    ExecutionEngine engine(config);
+    CHECK(engine.recovery_stats().snapshot_sequence == 0);
+    CHECK(engine.recovery_stats().last_sequence > last_sequence);
+    CHECK(same_books(engine, reference));
+    CHECK(same_positions(engine, reference));
+}
+
+TEST_CASE(snapshots_keep_icebergs_and_stops) {
+    test::ScratchDirectory directory("journal-snapshot-state");
+    EngineConfig config = journal_config(directory.path());
+    config.snapshots = true;
+    {
+        ExecutionEngine engine(config);
+        SymbolId symbol = engine.register_symbol("XYZ");
+        engine.submit_iceberg_order(symbol, to_ticks(100.0), 12, false, 4, 2);
+        engine.submit_stop_order(symbol, to_ticks(100.0), 5, true, OrderType::StopLimit, to_ticks(101.0), 3);
+        CHECK(engine.snapshot() != 0);
+    }
+    ExecutionEngine engine(config);
+    CHECK(engine.recovery_stats().replayed == 0);
+    SymbolId symbol = engine.find_symbol("XYZ");
+    CHECK(engine.get_top_of_book(symbol).ask_quantity == 4);
+    // A trade at 100 sets off the stop, which takes 5 more from the iceberg
+    engine.submit_order(symbol, to_ticks(100.0), 1, true, OrderType::Limit, 1);
+    TopOfBook top = engine.get_top_of_book(symbol);
+    CHECK(top.best_ask == to_ticks(100.0));
+    CHECK(top.ask_quantity == 2);
+    CHECK(top.best_bid == 0);
+    // Exactly 6 is left, most of it hidden
+    CHECK(engine.submit_order(symbol, to_ticks(100.0), 7, true, OrderType::FillOrKill) != 0);
+    CHECK(engine.get_top_of_book(symbol).ask_quantity == 2);
+    engine.submit_order(symbol, to_ticks(100.0), 6, true, OrderType::FillOrKill);
+    CHECK(engine.get_top_of_book(symbol).best_ask == 0);
+}
+
+TEST_MAIN
@@ -0,0 +1,385 @@
+#include "execution_engine.hpp"
+#include <vector>
+
+#include "test_support.hpp"
+
+using namespace trading;
+
+namespace {
+
+BookOrder limit(OrderId order_id, double price, int quantity, bool is_buy) {
+    return BookOrder{order_id, to_ticks(price), quantity, is_buy};
+}
+
+std::vector<OrderId> passive_ids(const std::vector<Fill>& fills) {
+    std::vector<OrderId> ids;
+    for (const Fill& fill : fills) {
+        ids.push_back(fill.passive_order_id);
+    }
+    return ids;
+}
+
+std::vector<int> fill_quantities(const std::vector<Fill>& fills) {
+    std::vector<int> quantities;
+    for (const Fill& fill : fills) {
+        quantities.push_back(fill.quantity);
+    }
+    return quantities;
+}
+
+} // anonymous namespace
+
+TEST_CASE(better_prices_fill_first_then_older_orders) {
+    OrderBook book("XYZ");
+    book.add_order(limit(1, 101.0, 10, false));
+    book.add_order(limit(2, 100.0, 10, false));
+    book.add_order(limit(3, 100.0, 10, false));
+    book.add_order(limit(4, 102.0, 10, false));
+    CHECK(book.get_best_ask() == 100.0);
+
+    std::vector<Fill> fills;
+    CHECK(!book.add_order(limit(5, 101.0, 25, true), &fills));
+    CHECK((passive_ids(fills) == std::vector<OrderId>{2, 3, 1}));
+    CHECK((fill_quantities(fills) == std::vector<int>{10, 10, 5}));
+    for (const Fill& fill : fills) {
+        CHECK(fill.aggressor_order_id == 5);
+        CHECK(fill.aggressor_is_buy);
+    }
+    CHECK(fills[2].price == to_ticks(101.0));
+    CHECK(fills[0].sequence == 1 && fills[2].sequence == 3);
+
+    TopOfBook top = book.get_top_of_book();
+    CHECK(top.best_ask == to_ticks(101.0));
+    CHECK(top.ask_quantity == 5);
+    CHECK(top.best_bid == 0);
+    CHECK(top.last_trade_price == to_ticks(101.0));
+}
+
+TEST_CASE(trades_print_at_the_resting_price) {
+    OrderBook book("XYZ");
+    book.add_order(limit(1, 99.0, 10, true));
+    std::vector<Fill> fills;
+    book.add_order(limit(2, 95.0, 4, false), &fills);
+    CHECK(fills.size() == 1);
+    CHECK(fills[0].price == to_ticks(99.0));
+    CHECK(book.get_last_trade_price() == 99.0);
+    CHECK(book.get_top_of_book().bid_quantity == 6);
+}
+
+TEST_CASE(an_uncrossed_remainder_rests) {
+    OrderBook book("XYZ");
+    book.add_order(limit(1, 100.0, 5, false));
+    std::vector<Fill> fills;
+    CHECK(book.add_order(limit(2, 100.0, 8, true), &fills));
+    CHECK(fills.size() == 1);
+    TopOfBook top = book.get_top_of_book();
+    CHECK(top.best_bid == to_ticks(100.0));
+    CHECK(top.bid_quantity == 3);
+    CHECK(top.best_ask == 0);
+}
+
+TEST_CASE(cancel_removes_an_order_and_its_empty_level) {
+    OrderBook book("XYZ");
+    book.add_order(limit(1, 100.0, 10, true));
+    book.add_order(limit(2, 100.0, 10, true));
+    book.add_order(limit(3, 99.0, 10, true));
+
+    CHECK(book.cancel(1));
+    CHECK(!book.cancel(1));
+    CHECK(!book.cancel(42));
+    CHECK(book.get_top_of_book().bid_quantity == 10);
+
+    CHECK(book.cancel(2));
+    CHECK(book.get_best_bid() == 99.0);
+
+    std::vector<Fill> fills;
+    book.add_order(limit(4, 99.0, 10, false), &fills);
+    CHECK((passive_ids(fills) == std::vector<OrderId>{3}));
+    CHECK(book.get_best_bid() == 0.0);
+}
+
+TEST_CASE(cancel_all_empties_the_book) {
+    OrderBook book("XYZ");
+    book.add_order(limit(1, 100.0, 10, true));
+    book.add_order(limit(2, 101.0, 10, false));
+    book.add_order(BookOrder{3, to_ticks(105.0), 10, true, OrderType::Stop, 0, to_ticks(105.0)});
+    CHECK(book.cancel_all() == 3);
+    CHECK(book.get_top_of_book() == TopOfBook{});
+    CHECK(!book.cancel(3));
+}
+
+TEST_CASE(engine_cancels_by_order_id_text) {
+    ExecutionEngine engine;
+    std::string order_id = engine.submit_order(Order{"", "XYZ", 100.0, 10, true});
+    CHECK(parse_order_id(order_id) != 0);
+    CHECK(engine.get_best_bid("XYZ") == 100.0);
+    CHECK(engine.cancel_order(order_id));
+    CHECK(!engine.cancel_order(order_id));
+    CHECK(!engine.cancel_order("not-an-order"));
+    CHECK(engine.get_best_bid("XYZ") == 0.0);
+}
+
+TEST_CASE(modify_down_keeps_queue_position) {
+    OrderBook book("XYZ");
+    book.add_order(limit(1, 100.0, 10, false));
+    book.add_order(limit(2, 100.0, 10, false));
+    CHECK(book.modify(1, to_ticks(100.0), 4));
+    CHECK(book.get_top_of_book().ask_quantity == 14);
+
+    std::vector<Fill> fills;
+    book.add_order(limit(3, 100.0, 6, true), &fills);
+    CHECK((passive_ids(fills) == std::vector<OrderId>{1, 2}));
+    CHECK((fill_quantities(fills) == std::vector<int>{4, 2}));
+}
+
+TEST_CASE(modify_up_or_to_a_new_price_requeues) {
+    OrderBook book("XYZ");
+    book.add_order(limit(1, 100.0, 10, false));
+    book.add_order(limit(2, 100.0, 10, false));
+    book.add_order(limit(3, 100.0, 10, false));
+    CHECK(book.modify(1, to_ticks(100.0), 12));
+    CHECK(book.modify(2, to_ticks(101.0), 10));
+    CHECK(book.modify(2, to_ticks(100.0), 10));
+
+    std::vector<Fill> fills;
+    book.add_order(limit(4, 100.0, 32, true), &fills);
+    CHECK((passive_ids(fills) == std::vector<OrderId>{3, 1, 2}));
+    CHECK((fill_quantities(fills) == std::vector<int>{10, 12, 10}));
+}
+
+TEST_CASE(modify_to_a_crossing_price_trades) {
+    OrderBook book("XYZ");
+    book.add_order(limit(1, 99.0, 10, true));
+    book.add_order(limit(2, 101.0, 10, false));
+    std::vector<Fill> fills;
+    CHECK(book.modify(1, to_ticks(101.0), 15, &fills));
+    CHECK((passive_ids(fills) == std::vector<OrderId>{2}));
+    CHECK(fills[0].aggressor_order_id == 1);
+    TopOfBook top = book.get_top_of_book();
+    CHECK(top.best_bid == to_ticks(101.0));
+    CHECK(top.bid_quantity == 5);
+    CHECK(top.best_ask == 0);
+}
+
+TEST_CASE(modify_to_zero_cancels_and_unknown_orders_fail) {
+    OrderBook book("XYZ");
+    book.add_order(limit(1, 100.0, 10, true));
+    CHECK(book.modify(1, to_ticks(100.0), 0));
+    CHECK(book.get_best_bid() == 0.0);
+    CHECK(!book.modify(1, to_ticks(100.0), 5));
+    CHECK(!book.modify(7, to_ticks(100.0), 5));
+}
+
+TEST_CASE(ioc_takes_what_it_can_and_drops_the_rest) {
+    OrderBook book("XYZ");
+    book.add_order(limit(1, 100.0, 5, false));
+    book.add_order(limit(2, 102.0, 5, false));
+    std::vector<Fill> fills;
+    BookOrder ioc = limit(3, 101.0, 8, true);
+    ioc.type = OrderType::ImmediateOrCancel;
+    CHECK(!book.add_order(ioc, &fills));
+    CHECK((fill_quantities(fills) == std::vector<int>{5}));
+    TopOfBook top = book.get_top_of_book();
+    CHECK(top.best_bid == 0);
+    CHECK(top.best_ask == to_ticks(102.0));
+}
+
+TEST_CASE(fok_fills_completely_or_not_at_all) {
+    OrderBook book("XYZ");
+    book.add_order(limit(1, 100.0, 5, false));
+    book.add_order(limit(2, 101.0, 5, false));
+    std::vector<Fill> fills;
+    BookOrder fok = limit(3, 101.0, 11, true);
+    fok.type = OrderType::FillOrKill;
+    CHECK(!book.add_order(fok, &fills));
+    CHECK(fills.empty());
+    CHECK(book.get_top_of_book().ask_quantity == 5);
+
+    fok.order_id = 4;
+    fok.quantity = 10;
+    CHECK(!book.add_order(fok, &fills));
+    CHECK((passive_ids(fills) == std::vector<OrderId>{1, 2}));
+    CHECK(book.get_best_ask() == 0.0);
+}
+
+TEST_CASE(fok_counts_hidden_iceberg_size) {
+    OrderBook book("XYZ");
+    BookOrder iceberg = limit(1, 100.0, 20, false);
+    iceberg.display_quantity = 5;
+    book.add_order(iceberg);
+    CHECK(book.get_top_of_book().ask_quantity == 5);
+
+    std::vector<Fill> fills;
+    BookOrder fok = limit(2, 100.0, 18, true);
+    fok.type = OrderType::FillOrKill;
+    CHECK(!book.add_order(fok, &fills));
+    CHECK((fill_quantities(fills) == std::vector<int>{5, 5, 5, 3}));
+    CHECK(book.get_top_of_book().ask_quantity == 2);
+
+    fills.clear();
+    fok.order_id = 3;
+    fok.quantity = 3;
+    CHECK(!book.add_order(fok, &fills));
+    CHECK(fills.empty());
+}
+
+TEST_CASE(post_only_rests_or_is_dropped) {
+    OrderBook book("XYZ");
+    book.add_order(limit(1, 101.0, 5, false));
+    std::vector<Fill> fills;
+    BookOrder post = limit(2, 101.0, 5, true);
+    post.type = OrderType::PostOnly;
+    CHECK(!book.add_order(post, &fills));
+    CHECK(fills.empty());
+    CHECK(book.get_best_bid() == 0.0);
+
+    post.order_id = 3;
+    post.price = to_ticks(100.0);
+    CHECK(book.add_order(post, &fills));
+    CHECK(fills.empty());
+    CHECK(book.get_best_bid() == 100.0);
+}
+
+TEST_CASE(market_orders_sweep_any_price_and_never_rest) {
+    OrderBook book("XYZ");
+    book.add_order(limit(1, 100.0, 5, false));
+    book.add_order(limit(2, 150.0, 5, false));
+    std::vector<Fill> fills;
+    BookOrder market = limit(3, 0.0, 12, true);
+    market.type = OrderType::Market;
+    CHECK(!book.add_order(market, &fills));
+    CHECK((passive_ids(fills) == std::vector<OrderId>{1, 2}));
+    CHECK(fills[1].price == to_ticks(150.0));
+    CHECK(book.get_top_of_book() == (TopOfBook{0, 0, 0, 0, to_ticks(150.0)}));
+}
+
+TEST_CASE(iceberg_refills_at_the_back_of_its_level) {
+    OrderBook book("XYZ");
+    BookOrder iceberg = limit(1, 100.0, 12, false);
+    iceberg.display_quantity = 5;
+    CHECK(book.add_order(iceberg));
+    book.add_order(limit(2, 100.0, 5, false));
+    CHECK(book.get_top_of_book().ask_quantity == 10);
+
+    std::vector<Fill> fills;
+    book.add_order(limit(3, 100.0, 8, true), &fills);
+    CHECK((passive_ids(fills) == std::vector<OrderId>{1, 2}));
+    CHECK((fill_quantities(fills) == std::vector<int>{5, 3}));
+    // The refill of 5 queues behind what is left of order 2
+    CHECK(book.get_top_of_book().ask_quantity == 7);
+
+    fills.clear();
+    book.add_order(limit(4, 100.0, 9, true), &fills);
+    CHECK((passive_ids(fills) == std::vector<OrderId>{2, 1, 1}));
+    CHECK((fill_quantities(fills) == std::vector<int>{2, 5, 2}));
+    CHECK(book.get_best_ask() == 0.0);
+}
+
+TEST_CASE(iceberg_modify_resizes_the_reserve_first) {
+    OrderBook book("XYZ");
+    BookOrder iceberg = limit(1, 100.0, 20, true);
+    iceberg.display_quantity = 5;
+    book.add_order(iceberg);
+    book.add_order(limit(2, 100.0, 5, true));
+    CHECK(book.modify(1, to_ticks(100.0), 7));
+    CHECK(book.get_top_of_book().bid_quantity == 10);
+
+    std::vector<Fill> fills;
+    book.add_order(limit(3, 100.0, 7, false), &fills);
+    // Still first in the queue, with 2 left behind the display
+    CHECK((passive_ids(fills) == std::vector<OrderId>{1, 2}));
+    CHECK((fill_quantities(fills) == std::vector<int>{5, 2}));
+    CHECK(book.get_top_of_book().bid_quantity == 5);
+}
+
+TEST_CASE(engine_rejects_a_peak_on_anything_but_a_limit_order) {
+    ExecutionEngine engine;
+    engine.submit_order(Order{"", "XYZ", 101.0, 10, false});
+    for (OrderType type : {OrderType::Market, OrderType::ImmediateOrCancel, OrderType::FillOrKill,
+                           OrderType::PostOnly, OrderType::Stop, OrderType::StopLimit}) {
+        Order order{"", "XYZ", 101.0, 20, true, type, 5, 100.0};
+        CHECK(engine.submit_order(order).empty());
+    }
+    CHECK(engine.get_top_of_book(engine.find_symbol("XYZ")).ask_quantity == 10);
+    CHECK(engine.get_best_bid("XYZ") == 0.0);
+
+    Order iceberg{"", "XYZ", 100.0, 20, true, OrderType::Limit, 5};
+    CHECK(!engine.submit_order(iceberg).empty());
+    CHECK(engine.get_top_of_book(engine.find_symbol("XYZ")).bid_quantity == 5);
+}
+
+TEST_CASE(stops_wait_for_a_trade_through_their_price) {
+    OrderBook book("XYZ");
+    book.add_order(limit(1, 101.0, 5, false));
+    book.add_order(limit(2, 102.0, 5, false));
+    BookOrder stop{3, 0, 5, true, OrderType::Stop, 0, to_ticks(101.0)};
+    CHECK(book.add_order(stop));
+    CHECK(book.get_top_of_book().ask_quantity == 5);
+
+    std::vector<Fill> fills;
+    book.add_order(limit(4, 100.0, 5, false));
+    book.add_order(limit(5, 100.0, 5, true), &fills);
+    // A trade at 100 is below the trigger
+    CHECK(fills.size() == 1);
+    CHECK(book.get_best_ask() == 101.0);
+
+    fills.clear();
+    book.add_order(limit(6, 101.0, 2, true), &fills);
+    CHECK((passive_ids(fills) == std::vector<OrderId>{1, 1, 2}));
+    CHECK(fills[1].aggressor_order_id == 3);
+    CHECK((fill_quantities(fills) == std::vector<int>{2, 3, 2}));
+    CHECK(book.get_best_ask() == 102.0);
+    CHECK(!book.cancel(3));
+}
+
+TEST_CASE(stop_limit_rests_at_its_limit) {
+    OrderBook book("XYZ");
+    book.add_order(limit(1, 99.0, 5, true));
+    book.add_order(limit(2, 97.0, 5, true));
+    CHECK(book.add_order(BookOrder{3, to_ticks(98.0), 8, false, OrderType::StopLimit, 0, to_ticks(99.0)}));
+
+    std::vector<Fill> fills;
+    book.add_order(limit(4, 99.0, 5, false), &fills);
+    // The stop fired at 99 but the bid at 97 is below its limit
+    CHECK(fills.size() == 1);
+    TopOfBook top = book.get_top_of_book();
+    CHECK(top.best_ask == to_ticks(98.0));
+    CHECK(top.ask_quantity == 8);
+    CHECK(top.best_bid == to_ticks(97.0));
+}
+
+TEST_CASE(stops_cascade_through_each_others_trades) {
+    OrderBook book("XYZ");
+    for (OrderId id = 1; id <= 4; ++id) {
+        book.add_order(limit(id, 100.0 - static_cast<double>(id), 5, true));
+    }
+    // Each fire trades one level lower, which sets off the next stop
+    book.add_order(BookOrder{10, 0, 5, false, OrderType::Stop, 0, to_ticks(99.0)});
+    book.add_order(BookOrder{11, 0, 5, false, OrderType::Stop, 0, to_ticks(98.0)});
+    book.add_order(BookOrder{12, 0, 5, false, OrderType::Stop, 0, to_ticks(97.0)});
+    book.add_order(BookOrder{13, 0, 5, false, OrderType::Stop, 0, to_ticks(90.0)});
+
+    std::vector<Fill> fills;
+    book.add_order(limit(20, 99.0, 5, false), &fills);
+    std::vector<OrderId> aggressors;
+    for (const Fill& fill : fills) {
+        aggressors.push_back(fill.aggressor_order_id);
+    }
+    CHECK((aggressors == std::vector<OrderId>{20, 10, 11, 12}));
+    CHECK((passive_ids(fills) == std::vector<OrderId>{1, 2, 3, 4}));
+    CHECK(book.get_best_bid() == 0.0);
+    CHECK(book.get_last_trade_price() == 96.0);
+    CHECK(book.cancel(13));
+}
+
+TEST_CASE(a_stop_already_crossed_fires_on_arrival) {
+    OrderBook book("XYZ");
+    book.add_order(limit(1, 100.0, 5, false));
+    book.add_order(limit(2, 100.0, 1, true));
+    std::vector<Fill> fills;
+    CHECK(!book.add_order(BookOrder{3, 0, 4, true, OrderType::Stop, 0, to_ticks(99.0)}, &fills));
+    CHECK((fill_quantities(fills) == std::vector<int>{4}));
+    CHECK(book.get_best_ask() == 0.0);
+}
+
+TEST_MAIN
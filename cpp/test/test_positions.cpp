@@ -0,0 +1,223 @@
+#include "execution_engine.hpp"
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "test_support.hpp"
+
+using namespace trading;
+
+namespace {
+
+// Positions are booked by the accounting thread, so tests poll for them
+template <typename Condition>
+bool eventually(Condition condition) {
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+    while (!condition()) {
+        if (std::chrono::steady_clock::now() > deadline) {
+            return false;
+        }
+        std::this_thread::yield();
+    }
+    return true;
+}
+
+} // anonymous namespace
+
+TEST_CASE(adding_blends_the_average_and_reducing_realizes) {
+    Position position;
+    position.apply(true, 100.0, 10);
+    position.apply(true, 110.0, 10);
+    CHECK(position.quantity == 20);
+    CHECK(position.average_price == 105.0);
+
+    position.apply(false, 120.0, 5);
+    CHECK(position.quantity == 15);
+    CHECK(position.average_price == 105.0);
+    CHECK(position.realized_pnl == 75.0);
+    CHECK(position.unrealized_pnl(107.0) == 30.0);
+}
+
+TEST_CASE(going_flat_resets_the_average) {
+    Position position;
+    position.apply(true, 100.0, 10);
+    position.apply(false, 90.0, 10);
+    CHECK(position.quantity == 0);
+    CHECK(position.average_price == 0.0);
+    CHECK(position.realized_pnl == -100.0);
+
+    position.apply(false, 50.0, 4);
+    CHECK(position.quantity == -4);
+    CHECK(position.average_price == 50.0);
+}
+
+TEST_CASE(flipping_restarts_the_average_at_the_fill) {
+    Position position;
+    position.apply(false, 100.0, 10);
+    position.apply(true, 90.0, 15);
+    CHECK(position.quantity == 5);
+    CHECK(position.average_price == 90.0);
+    CHECK(position.realized_pnl == 100.0);
+    CHECK(position.unrealized_pnl(92.0) == 10.0);
+}
+
+TEST_CASE(engine_books_both_accounts_of_a_fill) {
+    ExecutionEngine engine;
+    SymbolId symbol = engine.register_symbol("XYZ");
+    engine.submit_order(symbol, to_ticks(100.0), 10, false, OrderType::Limit, 2);
+    engine.submit_order(symbol, to_ticks(100.0), 4, true, OrderType::Limit, 1);
+    engine.submit_order(symbol, to_ticks(99.0), 1, true, OrderType::Limit, 3);
+
+    CHECK(eventually([&] { return engine.get_position(1, symbol) == 4; }));
+    CHECK(eventually([&] { return engine.get_position(2, symbol) == -4; }));
+    CHECK(engine.get_position(3, symbol) == 0);
+    CHECK(engine.get_position("XYZ") == 0);
+    CHECK(engine.get_average_price(1, "XYZ") == 100.0);
+    // Marked to the mid of 99 and 100
+    CHECK(engine.get_unrealized_pnl(1, symbol) == -2.0);
+    CHECK(engine.get_unrealized_pnl(2, symbol) == 2.0);
+
+    engine.submit_order(symbol, to_ticks(100.0), 4, false, OrderType::Limit, 1);
+    engine.submit_order(symbol, to_ticks(100.0), 10, true, OrderType::Limit, 2);
+    CHECK(eventually([&] { return engine.get_position(1, symbol) == 0; }));
+    Position flat = engine.get_position_snapshot(1, symbol);
+    CHECK(flat.average_price == 0.0);
+    CHECK(flat.realized_pnl == 0.0);
+    CHECK(eventually([&] { return engine.get_position(2, symbol) == 0; }));
+}
+
+TEST_CASE(seqlock_readers_never_see_a_torn_value) {
+    struct Triple {
+        std::uint64_t a, b, c;
+    };
+    Seqlock<Triple> lock;
+    std::atomic<bool> done{false};
+    std::atomic<int> torn{0};
+    std::vector<std::thread> readers;
+    for (int r = 0; r < 2; ++r) {
+        readers.emplace_back([&] {
+            while (!done.load(std::memory_order_relaxed)) {
+                Triple value = lock.load();
+                if (value.a != value.b || value.b != value.c) {
+                    torn.fetch_add(1);
+                }
+            }
+        });
+    }
+    for (std::uint64_t i = 1; i <= 200000; ++i) {
+        lock.store(Triple{i, i, i});
+    }
+    done.store(true);
+    for (std::thread& reader : readers) {
+        reader.join();
+    }
+    CHECK(torn.load() == 0);
+    CHECK(lock.load().c == 200000);
+}
+
+TEST_CASE(position_lookups_race_inserts_safely) {
+    PositionKeeper keeper;
+    constexpr SymbolId kSymbols = 20000;
+    std::atomic<SymbolId> booked{0};
+    std::atomic<int> wrong{0};
+
+    std::thread reader([&] {
+        SymbolId next = 0;
+        while (booked.load(std::memory_order_acquire) < kSymbols) {
+            SymbolId count = booked.load(std::memory_order_acquire);
+            if (count == 0) {
+                continue;
+            }
+            next = (next + 7919) % count;
+            if (keeper.get(1, next).quantity != 3 || keeper.get(2, next).quantity != -3) {
+                wrong.fetch_add(1);
+            }
+        }
+    });
+    for (SymbolId symbol = 0; symbol < kSymbols; ++symbol) {
+        keeper.apply(symbol, Fill{1, 2, to_ticks(10.0), 3, true, 1, 0, 1, 2});
+        booked.store(symbol + 1, std::memory_order_release);
+    }
+    reader.join();
+
+    CHECK(wrong.load() == 0);
+    CHECK(keeper.get(3, 0).quantity == 0);
+    std::vector<PositionKeeper::Entry> entries;
+    keeper.save(entries);
+    CHECK(entries.size() == 2 * kSymbols);
+}
+
+TEST_CASE(symbol_lookups_race_registration_safely) {
+    ExecutionEngine engine;
+    constexpr int kSymbols = 5000;
+    std::atomic<int> registered{0};
+    std::atomic<int> wrong{0};
+
+    std::thread reader([&] {
+        int next = 0;
+        while (registered.load(std::memory_order_acquire) < kSymbols) {
+            int count = registered.load(std::memory_order_acquire);
+            if (count == 0) {
+                continue;
+            }
+            next = (next + 31) % count;
+            if (engine.find_symbol("S" + std::to_string(next)) != static_cast<SymbolId>(next)) {
+                wrong.fetch_add(1);
+            }
+        }
+    });
+    for (int i = 0; i < kSymbols; ++i) {
+        engine.register_symbol("S" + std::to_string(i));
+        registered.store(i + 1, std::memory_order_release);
+    }
+    reader.join();
+
+    CHECK(wrong.load() == 0);
+    CHECK(engine.find_symbol("missing") == kInvalidSymbol);
+    CHECK(engine.register_symbol("S42") == 42);
+}
+
+TEST_CASE(registry_stops_at_capacity) {
+    SymbolRegistry registry(2);
+    CHECK(registry.intern("A") == 0);
+    CHECK(registry.intern("B") == 1);
+    CHECK(registry.intern("C") == kInvalidSymbol);
+    CHECK(registry.intern("A") == 0);
+    CHECK(registry.find("B") == 1);
+    CHECK(registry.name(1) == "B");
+}
+
+TEST_CASE(batch_getters_match_the_single_ones) {
+    ExecutionEngine engine;
+    SymbolId a = engine.register_symbol("AAA");
+    SymbolId b = engine.register_symbol("BBB");
+    engine.submit_order(a, to_ticks(50.0), 5, false, OrderType::Limit, 2);
+    engine.submit_order(a, to_ticks(50.0), 5, true, OrderType::Limit, 1);
+    engine.submit_order(b, to_ticks(20.0), 3, true, OrderType::Limit, 2);
+    engine.submit_order(b, to_ticks(20.0), 2, false, OrderType::Limit, 1);
+    engine.submit_order(b, to_ticks(21.0), 7, false);
+    CHECK(eventually([&] { return engine.get_position(1, b) == -2; }));
+
+    std::vector<SymbolId> ids{a, b, 999};
+    std::vector<Position> positions(ids.size());
+    engine.get_position_snapshots(1, ids, positions);
+    CHECK(positions[0].quantity == 5);
+    CHECK(positions[0].average_price == 50.0);
+    CHECK(positions[1].quantity == -2);
+    CHECK(positions[1].average_price == 20.0);
+    CHECK(positions[2].quantity == 0);
+
+    std::vector<TopOfBook> tops(ids.size());
+    engine.get_top_of_books(ids, tops);
+    CHECK(tops[0] == engine.get_top_of_book(a));
+    CHECK(tops[0].last_trade_price == to_ticks(50.0));
+    CHECK(tops[1].best_bid == to_ticks(20.0));
+    CHECK(tops[1].bid_quantity == 1);
+    CHECK(tops[1].best_ask == to_ticks(21.0));
+    CHECK(tops[1].ask_quantity == 7);
+    CHECK(tops[2] == TopOfBook{});
+}
+
+TEST_MAIN
@@ -0,0 +1,275 @@
+#include "market_replay.hpp"
+#include "tick_store.hpp"
+#include <algorithm>
+#include <chrono>
+#include <memory>
+#include <random>
+#include <string>
+#include <thread>
+#include <tuple>
+#include <vector>
+
+#include "test_support.hpp"
+
+using namespace trading;
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+struct Tick {
+    std::string symbol;
+    Timestamp timestamp;
+    double price;
+
+    bool operator==(const Tick&) const = default;
+};
+
+EngineConfig replay_config() {
+    EngineConfig config;
+    config.dispatch_threads = 0;
+    return config;
+}
+
+// Records every tick of the symbols on the market data thread
+void follow(ExecutionEngine& engine, const std::vector<std::string>& symbols, std::vector<Tick>& ticks) {
+    for (const std::string& symbol : symbols) {
+        engine.subscribe_market_data(symbol, [&ticks](const MarketData& data) {
+            ticks.push_back(Tick{data.symbol, data.timestamp, data.price});
+        });
+    }
+}
+
+bool wait_finished(const ReplayMarketData& replay) {
+    auto deadline = Clock::now() + std::chrono::seconds(30);
+    while (!replay.finished()) {
+        if (Clock::now() > deadline) {
+            return false;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    return true;
+}
+
+// Writes random ticks for each symbol, in runs or one at a time, with
+// plenty of equal timestamps across symbols. Returns them in the order a
+// replay must deliver them: by timestamp, ties to the symbol listed first.
+std::vector<Tick> write_tape(const std::string& directory, const std::vector<std::string>& symbols, int ticks,
+                             bool runs, unsigned seed) {
+    std::mt19937_64 random(seed);
+    std::vector<std::tuple<Timestamp, std::size_t, int>> order;
+    for (std::size_t s = 0; s < symbols.size(); ++s) {
+        TickWriter writer(directory, symbols[s]);
+        Timestamp timestamp = 0;
+        for (int i = 0; i < ticks; ++i) {
+            timestamp += runs ? (i % 100 == 0 ? 1000 : 0) + static_cast<Timestamp>(random() % 2)
+                              : static_cast<Timestamp>(random() % 3);
+            double price = static_cast<double>(s * 1000000 + i);
+            writer.append(timestamp, price, 1.0);
+            order.emplace_back(timestamp, s, i);
+        }
+    }
+    std::sort(order.begin(), order.end());
+    std::vector<Tick> expected;
+    for (const auto& [timestamp, s, i] : order) {
+        expected.push_back(Tick{symbols[s], timestamp, static_cast<double>(s * 1000000 + i)});
+    }
+    return expected;
+}
+
+std::vector<std::string> symbol_names(int count) {
+    std::vector<std::string> names;
+    for (int i = 0; i < count; ++i) {
+        names.push_back("S" + std::to_string(10 + i));
+    }
+    return names;
+}
+
+} // anonymous namespace
+
+TEST_CASE(replay_merges_few_symbols_by_timestamp) {
+    for (bool runs : {false, true}) {
+        test::ScratchDirectory directory("replay-few");
+        std::vector<std::string> symbols = symbol_names(3);
+        std::vector<Tick> expected = write_tape(directory.path(), symbols, 5000, runs, 25);
+
+        ExecutionEngine engine(replay_config());
+        std::vector<Tick> ticks;
+        follow(engine, symbols, ticks);
+        auto replay = std::make_shared<ReplayMarketData>(directory.path(), 0.0);
+        engine.set_market_data_source(replay);
+        engine.start();
+        CHECK(wait_finished(*replay));
+        CHECK(replay->published() == expected.size());
+        CHECK(ticks == expected);
+    }
+}
+
+TEST_CASE(replay_merges_many_symbols_by_timestamp) {
+    for (bool runs : {false, true}) {
+        test::ScratchDirectory directory("replay-many");
+        std::vector<std::string> symbols = symbol_names(12);
+        std::vector<Tick> expected = write_tape(directory.path(), symbols, 2000, runs, 26);
+
+        ExecutionEngine engine(replay_config());
+        std::vector<Tick> ticks;
+        follow(engine, symbols, ticks);
+        auto replay = std::make_shared<ReplayMarketData>(directory.path(), 0.0);
+        engine.set_market_data_source(replay);
+        engine.start();
+        CHECK(wait_finished(*replay));
+        CHECK(ticks == expected);
+    }
+}
+
+TEST_CASE(replay_through_dispatch_threads_keeps_each_symbols_order) {
+    test::ScratchDirectory directory("replay-dispatch");
+    std::vector<std::string> symbols = symbol_names(3);
+    std::vector<Tick> expected = write_tape(directory.path(), symbols, 5000, false, 27);
+
+    EngineConfig config;
+    config.dispatch_threads = 2;
+    ExecutionEngine engine(config);
+    std::vector<std::vector<Tick>> per_symbol(symbols.size());
+    std::atomic<std::size_t> delivered{0};
+    for (std::size_t s = 0; s < symbols.size(); ++s) {
+        engine.subscribe_market_data(symbols[s], [&, s](const MarketData& data) {
+            per_symbol[s].push_back(Tick{data.symbol, data.timestamp, data.price});
+            delivered.fetch_add(1, std::memory_order_release);
+        });
+    }
+    auto replay = std::make_shared<ReplayMarketData>(directory.path(), 0.0);
+    engine.set_market_data_source(replay);
+    engine.start();
+    CHECK(wait_finished(*replay));
+    while (delivered.load(std::memory_order_acquire) < expected.size()) {
+        std::this_thread::yield();
+    }
+    engine.stop();
+    for (std::size_t s = 0; s < symbols.size(); ++s) {
+        std::vector<Tick> wanted;
+        std::copy_if(expected.begin(), expected.end(), std::back_inserter(wanted),
+                     [&](const Tick& tick) { return tick.symbol == symbols[s]; });
+        CHECK(per_symbol[s] == wanted);
+    }
+}
+
+TEST_CASE(replay_of_chosen_symbols_skips_the_rest) {
+    test::ScratchDirectory directory("replay-subset");
+    std::vector<std::string> symbols = symbol_names(3);
+    write_tape(directory.path(), symbols, 100, false, 28);
+
+    ExecutionEngine engine(replay_config());
+    std::vector<Tick> ticks;
+    follow(engine, symbols, ticks);
+    auto replay = std::make_shared<ReplayMarketData>(directory.path(), 0.0,
+                                                     std::vector<std::string>{symbols[2], "missing"});
+    engine.set_market_data_source(replay);
+    engine.start();
+    CHECK(wait_finished(*replay));
+    CHECK(ticks.size() == 100);
+    CHECK(std::all_of(ticks.begin(), ticks.end(), [&](const Tick& tick) { return tick.symbol == symbols[2]; }));
+    CHECK(engine.find_symbol("missing") == kInvalidSymbol);
+}
+
+TEST_CASE(paced_replay_keeps_the_gaps_scaled) {
+    test::ScratchDirectory directory("replay-paced");
+    {
+        // One second of ticks, replayed ten times faster
+        TickWriter writer(directory.path(), "XYZ");
+        for (int i = 0; i <= 1000; ++i) {
+            writer.append(Timestamp{1'000'000} * i, 1.0, 1.0);
+        }
+    }
+    ExecutionEngine engine(replay_config());
+    std::vector<Tick> ticks;
+    follow(engine, {"XYZ"}, ticks);
+    auto replay = std::make_shared<ReplayMarketData>(directory.path(), 10.0);
+    engine.set_market_data_source(replay);
+    Clock::time_point start = Clock::now();
+    engine.start();
+    CHECK(wait_finished(*replay));
+    double elapsed = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+    std::printf("paced 100 ms of ticks in %.1f ms\n", elapsed);
+    CHECK(ticks.size() == 1001);
+    CHECK(elapsed >= 95.0);
+    CHECK(elapsed < 2000.0);
+}
+
+TEST_CASE(stop_interrupts_a_paced_replay_promptly) {
+    test::ScratchDirectory directory("replay-stop");
+    {
+        // An hour of ticks, a second apart
+        TickWriter writer(directory.path(), "XYZ");
+        for (int i = 0; i < 3600; ++i) {
+            writer.append(Timestamp{1'000'000'000} * i, 1.0, 1.0);
+        }
+    }
+    ExecutionEngine engine(replay_config());
+    std::vector<Tick> ticks;
+    follow(engine, {"XYZ"}, ticks);
+    auto replay = std::make_shared<ReplayMarketData>(directory.path(), 1.0);
+    engine.set_market_data_source(replay);
+    engine.start();
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    Clock::time_point start = Clock::now();
+    engine.stop();
+    double elapsed = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+    CHECK(elapsed < 500.0);
+    CHECK(!replay->finished());
+    CHECK(replay->published() == 1);
+    CHECK(ticks.size() == 1);
+}
+
+TEST_CASE(start_after_a_finished_replay_replays_again) {
+    test::ScratchDirectory directory("replay-restart");
+    std::vector<std::string> symbols = symbol_names(2);
+    std::vector<Tick> expected = write_tape(directory.path(), symbols, 1000, false, 29);
+
+    ExecutionEngine engine(replay_config());
+    std::vector<Tick> ticks;
+    follow(engine, symbols, ticks);
+    auto replay = std::make_shared<ReplayMarketData>(directory.path(), 0.0);
+    engine.set_market_data_source(replay);
+    for (int run = 0; run < 2; ++run) {
+        engine.start();
+        CHECK(wait_finished(*replay));
+        CHECK(replay->published() == expected.size());
+    }
+    engine.stop();
+    CHECK(ticks.size() == 2 * expected.size());
+    CHECK(std::equal(expected.begin(), expected.end(), ticks.begin() + expected.size()));
+}
+
+TEST_CASE(replay_throughput) {
+    test::ScratchDirectory directory("replay-throughput");
+    std::vector<std::string> symbols = symbol_names(3);
+    constexpr Timestamp kTicks = 1'000'000;
+    for (std::size_t s = 0; s < symbols.size(); ++s) {
+        TickWriter writer(directory.path(), symbols[s]);
+        for (Timestamp i = 0; i < kTicks; ++i) {
+            writer.append(i * 3 + static_cast<Timestamp>(s), 100.0, 1.0);
+        }
+    }
+
+    ExecutionEngine engine(replay_config());
+    std::uint64_t delivered = 0;
+    for (const std::string& symbol : symbols) {
+        engine.subscribe_market_data(symbol, [&delivered](const MarketData&) { ++delivered; });
+    }
+    auto replay = std::make_shared<ReplayMarketData>(directory.path(), 0.0);
+    engine.set_market_data_source(replay);
+    Clock::time_point start = Clock::now();
+    engine.start();
+    CHECK(wait_finished(*replay));
+    double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+    double rate = static_cast<double>(delivered) / seconds / 1e6;
+    // bench_replay measures an optimized build; this only guards against
+    // the unoptimized one falling off a cliff
+    std::printf("replayed %llu interleaved ticks at %.1f M ticks/s\n", static_cast<unsigned long long>(delivered),
+                rate);
+    CHECK(delivered == 3 * kTicks);
+    CHECK(rate > 0.5);
+}
+
+TEST_MAIN
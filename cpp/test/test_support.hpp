@@ -0,0 +1,82 @@
+#pragma once
+
+#include <cstdio>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+#include <unistd.h>
+
+// Minimal assertion harness for the ctest targets: each test file defines
+// TEST_CASEs and ends with TEST_MAIN. A failed CHECK reports and carries
+// on, so one run shows every broken expectation.
+namespace trading::test {
+
+struct Case {
+    const char* name;
+    void (*run)();
+};
+
+inline std::vector<Case>& cases() {
+    static std::vector<Case> registered;
+    return registered;
+}
+
+inline int& failures() {
+    static int count = 0;
+    return count;
+}
+
+struct Registrar {
+    Registrar(const char* name, void (*run)()) { cases().push_back(Case{name, run}); }
+};
+
+inline int run_all() {
+    for (const Case& test : cases()) {
+        int before = failures();
+        test.run();
+        std::printf("%s %s\n", failures() == before ? "ok  " : "FAIL", test.name);
+    }
+    return failures() == 0 ? 0 : 1;
+}
+
+// Empty directory unique to this process, removed on destruction
+class ScratchDirectory {
+public:
+    explicit ScratchDirectory(const std::string& name)
+        : path_((std::filesystem::temp_directory_path() /
+                 ("trading-" + name + "-" + std::to_string(::getpid()))).string()) {
+        std::filesystem::remove_all(path_);
+        std::filesystem::create_directories(path_);
+    }
+    ~ScratchDirectory() {
+        std::error_code error;
+        std::filesystem::remove_all(path_, error);
+    }
+
+    ScratchDirectory(const ScratchDirectory&) = delete;
+    ScratchDirectory& operator=(const ScratchDirectory&) = delete;
+
+    const std::string& path() const { return path_; }
+
+private:
+    std::string path_;
+};
+
+} // namespace trading::test
+
+#define TEST_CASE(name)                                                   \
+    static void name();                                                   \
+    static const trading::test::Registrar name##_registrar(#name, name); \
+    static void name()
+
+#define CHECK(condition)                                                                       \
+    do {                                                                                       \
+        if (!(condition)) {                                                                    \
+            std::fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #condition); \
+            ++trading::test::failures();                                                       \
+        }                                                                                      \
+    } while (0)
+
+#define TEST_MAIN \
+    int main() { return trading::test::run_all(); }
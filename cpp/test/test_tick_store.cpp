@@ -0,0 +1,150 @@
+#include "tick_store.hpp"
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "test_support.hpp"
+
+using namespace trading;
+
+namespace {
+
+std::uintmax_t column_size(const std::string& directory, const std::string& symbol, const char* column) {
+    return std::filesystem::file_size(std::filesystem::path(tick_store_symbol_path(directory, symbol)) / column);
+}
+
+} // anonymous namespace
+
+TEST_CASE(ticks_read_back_and_columns_are_trimmed_on_close) {
+    test::ScratchDirectory directory("ticks-round-trip");
+    constexpr int kTicks = 100000;
+    {
+        TickWriter writer(directory.path(), "XYZ");
+        for (int i = 0; i < kTicks; ++i) {
+            CHECK(writer.append(1000 + i, 100.0 + i * 0.25, i % 7));
+        }
+        CHECK(writer.sync());
+        CHECK(writer.size() == kTicks);
+    }
+    for (const char* column : {"timestamp.col", "price.col", "volume.col"}) {
+        CHECK(column_size(directory.path(), "XYZ", column) == sizeof(TickColumnHeader) + kTicks * 8);
+    }
+
+    TickReader reader(directory.path(), "XYZ");
+    CHECK(reader.size() == kTicks);
+    int mismatches = 0;
+    for (int i = 0; i < kTicks; ++i) {
+        bool same = reader.timestamps()[i] == 1000 + i && reader.prices()[i] == 100.0 + i * 0.25 &&
+                    reader.volumes()[i] == i % 7;
+        mismatches += same ? 0 : 1;
+    }
+    CHECK(mismatches == 0);
+}
+
+TEST_CASE(reopening_appends_after_existing_ticks) {
+    test::ScratchDirectory directory("ticks-append");
+    for (int run = 0; run < 3; ++run) {
+        TickWriter writer(directory.path(), "XYZ");
+        CHECK(writer.size() == static_cast<std::size_t>(run * 10));
+        for (int i = 0; i < 10; ++i) {
+            writer.append(run * 10 + i, run, 1.0);
+        }
+    }
+    TickReader reader(directory.path(), "XYZ");
+    CHECK(reader.size() == 30);
+    bool in_order = true;
+    for (std::size_t i = 0; i < reader.size(); ++i) {
+        in_order = in_order && reader.timestamps()[i] == static_cast<Timestamp>(i) &&
+                   reader.prices()[i] == static_cast<double>(i / 10);
+    }
+    CHECK(in_order);
+    CHECK(column_size(directory.path(), "XYZ", "price.col") == sizeof(TickColumnHeader) + 30 * 8);
+}
+
+TEST_CASE(a_reader_sees_what_was_written_when_it_opened) {
+    test::ScratchDirectory directory("ticks-snapshot");
+    TickWriter writer(directory.path(), "XYZ");
+    writer.append(1, 1.0, 1.0);
+    TickReader before(directory.path(), "XYZ");
+    writer.append(2, 2.0, 2.0);
+    CHECK(before.size() == 1);
+    CHECK(TickReader(directory.path(), "XYZ").size() == 2);
+    CHECK(TickReader(directory.path(), "missing").empty());
+}
+
+TEST_CASE(symbols_with_unsafe_bytes_are_escaped) {
+    test::ScratchDirectory directory("ticks-escape");
+    for (const char* symbol : {"BRK/B", "ES%Z4", "AAPL"}) {
+        TickWriter writer(directory.path(), symbol);
+        writer.append(1, 1.0, 1.0);
+    }
+    // An empty symbol directory is not listed
+    std::filesystem::create_directories(tick_store_symbol_path(directory.path(), "EMPTY"));
+    CHECK(tick_store_symbols(directory.path()) == (std::vector<std::string>{"AAPL", "BRK/B", "ES%Z4"}));
+    CHECK(TickReader(directory.path(), "BRK/B").size() == 1);
+    CHECK(tick_store_symbols(directory.path() + "/missing").empty());
+}
+
+TEST_CASE(csv_import_keeps_decimal_timestamps_exact) {
+    test::ScratchDirectory directory("ticks-csv");
+    std::string csv = directory.path() + "/ticks.csv";
+    {
+        std::ofstream file(csv);
+        file << "symbol,timestamp,price,volume\n"
+             << "AAA,1700000000.123456789,10.5,100\r\n"
+             << "AAA,1700000000123456790,10.625,200\n"
+             << "B/B,1700000000.5,20,1\n"
+             << "AAA,1700000000.1234567915,10.75,1\n"
+             << "AAA,-1.25,1,1\n"
+             << "AAA,.5,1,1\n"
+             << "AAA,notatime,1,1\n"
+             << "AAA,1,2\n"
+             << "AAA,1,2,3,4\n"
+             << "AAA,99999999999.5,1,1\n"
+             << ",1,1,1\n";
+    }
+    std::string store = directory.path() + "/store";
+    TickImportStats stats = import_ticks_csv(csv, store);
+    CHECK(stats.imported == 6);
+    CHECK(stats.skipped == 6);
+
+    TickReader aaa(store, "AAA");
+    CHECK((std::vector<Timestamp>(aaa.timestamps().begin(), aaa.timestamps().end()) ==
+           std::vector<Timestamp>{1700000000123456789, 1700000000123456790, 1700000000123456792,
+                                  -1250000000, 500000000}));
+    CHECK(aaa.prices()[1] == 10.625);
+    CHECK(aaa.volumes()[1] == 200.0);
+    TickReader bb(store, "B/B");
+    CHECK(bb.size() == 1);
+    CHECK(bb.timestamps()[0] == 1700000000500000000);
+
+    bool threw = false;
+    try {
+        import_ticks_csv(directory.path() + "/missing.csv", store);
+    } catch (const std::system_error&) {
+        threw = true;
+    }
+    CHECK(threw);
+}
+
+TEST_CASE(recorder_writes_each_symbol_it_is_given) {
+    test::ScratchDirectory directory("ticks-recorder");
+    {
+        TickRecorder recorder(directory.path());
+        MarketDataCallback aaa = recorder.callback("AAA");
+        MarketDataCallback bbb = recorder.callback("BBB");
+        for (int i = 0; i < 1000; ++i) {
+            aaa(MarketData{"AAA", 10.0 + i, 1.0, i, 0});
+            if (i % 2 == 0) {
+                bbb(MarketData{"BBB", 20.0, 2.0, i, 0});
+            }
+        }
+        CHECK(recorder.dropped() == 0);
+    }
+    CHECK(TickReader(directory.path(), "AAA").size() == 1000);
+    CHECK(TickReader(directory.path(), "BBB").size() == 500);
+    CHECK(TickReader(directory.path(), "AAA").prices()[999] == 1009.0);
+}
+
+TEST_MAIN
@@ -10,6 +10,19 @@ let order_side = enum "order_side" [
   Sell, 1;
 ]
 
+type order_type =
+  | Limit | Market | Immediate_or_cancel | Fill_or_kill | Post_only
+  | Stop | Stop_limit
+let order_type = enum "order_type" [
+  Limit, 0;
+  Market, 1;
+  Immediate_or_cancel, 2;
+  Fill_or_kill, 3;
+  Post_only, 4;
+  Stop, 5;
+  Stop_limit, 6;
+]
+
 type order = {
   symbol: string;
   price: float;
@@ -36,10 +49,82 @@ type market_data = {
   timestamp: float;
 }
 
+(* Batch getter results, one array entry per symbol *)
+type position_columns = {
+  symbol_ids: int array;
+  positions: int array;
+  average_prices: float array;
+  realized_pnls: float array;
+  unrealized_pnls: float array;
+}
+
+type top_of_book_columns = {
+  best_bids: float array;
+  best_asks: float array;
+  bid_quantities: int array;
+  ask_quantities: int array;
+  last_prices: float array;
+}
+
+type depth_action = Level_add | Level_change | Level_delete
+
+type depth_update = {
+  action: depth_action;
+  side: order_side;
+  price: float;
+  quantity: int;
+  sequence: int64;
+}
+
+(* Best first; sequence is the last depth update already reflected *)
+type depth_snapshot = {
+  bids: (float * int) array;
+  asks: (float * int) array;
+  sequence: int64;
+}
+
+type l3_event_type = L3_add | L3_execute | L3_cancel | L3_replace
+
+(* One order-level book event; other_order_id is the aggressor of an
+   execute. Order ids are in the same form submit_order returns. *)
+type l3_event = {
+  event_type: l3_event_type;
+  symbol_id: int;
+  side: order_side;
+  order_id: string;
+  other_order_id: string;
+  price: float;
+  quantity: int;
+  remaining_quantity: int;
+  sequence: int64;
+  timestamp: int64;
+}
+
 (* C++ class wrapper *)
 type execution_engine
 let execution_engine : execution_engine structure typ = structure "ExecutionEngine"
 
+type l3_reader
+let l3_reader : l3_reader structure typ = structure "L3Reader"
+
+(* Mirrors trading::L3Event field for field *)
+type l3_event_raw
+let l3_event_raw : l3_event_raw structure typ = structure "L3Event"
+let l3_sequence = field l3_event_raw "sequence" uint64_t
+let l3_timestamp = field l3_event_raw "timestamp" int64_t
+let l3_order_id = field l3_event_raw "order_id" uint64_t
+let l3_other_order_id = field l3_event_raw "other_order_id" uint64_t
+let l3_price = field l3_event_raw "price" int64_t
+let l3_quantity = field l3_event_raw "quantity" int32_t
+let l3_remaining_quantity = field l3_event_raw "remaining_quantity" int32_t
+let l3_symbol = field l3_event_raw "symbol" uint32_t
+let l3_type = field l3_event_raw "type" uint8_t
+let l3_is_buy = field l3_event_raw "is_buy" bool
+let () = seal l3_event_raw
+
+(* Prices cross the L3 feed in ticks *)
+let ticks_per_unit = 10000.
+
 (* Function bindings *)
 let create_execution_engine = 
   foreign "new_execution_engine" (void @-> returning (ptr execution_engine))
@@ -53,6 +138,24 @@ let start_engine =
 let stop_engine =
   foreign "stop_engine" (ptr execution_engine @-> returning void)
 
+let register_symbol =
+  foreign "register_symbol" (
+    ptr execution_engine @->
+    string @-> (* symbol *)
+    returning int
+  )
+
+let submit_order_by_id =
+  foreign "submit_order_by_id" (
+    ptr execution_engine @->
+    int @-> (* symbol_id *)
+    double @-> (* price *)
+    int @-> (* quantity *)
+    order_side @-> (* side *)
+    order_type @-> (* order_type *)
+    returning string_opt
+  )
+
 let submit_order =
   foreign "submit_order" (
     ptr execution_engine @->
@@ -63,6 +166,41 @@ let submit_order =
     returning string
   )
 
+let submit_iceberg_order =
+  foreign "submit_iceberg_order" (
+    ptr execution_engine @->
+    int @-> (* symbol_id *)
+    double @-> (* price *)
+    int @-> (* quantity *)
+    order_side @-> (* side *)
+    int @-> (* display_quantity *)
+    returning string_opt
+  )
+
+let submit_stop_order =
+  foreign "submit_stop_order" (
+    ptr execution_engine @->
+    int @-> (* symbol_id *)
+    double @-> (* stop_price *)
+    double @-> (* limit_price *)
+    int @-> (* quantity *)
+    order_side @-> (* side *)
+    order_type @-> (* Stop or Stop_limit *)
+    returning string_opt
+  )
+
+let submit_account_order =
+  foreign "submit_account_order" (
+    ptr execution_engine @->
+    uint @-> (* account *)
+    int @-> (* symbol_id *)
+    double @-> (* price *)
+    int @-> (* quantity *)
+    order_side @-> (* side *)
+    order_type @-> (* order_type *)
+    returning string_opt
+  )
+
 let cancel_order =
   foreign "cancel_order" (
     ptr execution_engine @->
@@ -70,6 +208,22 @@ let cancel_order =
     returning bool
   )
 
+let modify_order =
+  foreign "modify_order" (
+    ptr execution_engine @->
+    string @-> (* order_id *)
+    double @-> (* price *)
+    int @-> (* quantity *)
+    returning bool
+  )
+
+let cancel_all_orders =
+  foreign "cancel_all_orders" (
+    ptr execution_engine @->
+    string @-> (* symbol *)
+    returning int
+  )
+
 let get_position =
   foreign "get_position" (
     ptr execution_engine @->
@@ -98,9 +252,133 @@ let get_realized_pnl =
     returning double
   )
 
+let get_best_bid =
+  foreign "get_best_bid" (
+    ptr execution_engine @->
+    string @-> (* symbol *)
+    returning double
+  )
+
+let get_best_ask =
+  foreign "get_best_ask" (
+    ptr execution_engine @->
+    string @-> (* symbol *)
+    returning double
+  )
+
+let get_account_position =
+  foreign "get_account_position" (
+    ptr execution_engine @->
+    uint @-> (* account *)
+    string @-> (* symbol *)
+    returning int
+  )
+
+let get_account_average_price =
+  foreign "get_account_average_price" (
+    ptr execution_engine @->
+    uint @-> (* account *)
+    string @-> (* symbol *)
+    returning double
+  )
+
+let get_account_unrealized_pnl =
+  foreign "get_account_unrealized_pnl" (
+    ptr execution_engine @->
+    uint @-> (* account *)
+    string @-> (* symbol *)
+    returning double
+  )
+
+let get_account_realized_pnl =
+  foreign "get_account_realized_pnl" (
+    ptr execution_engine @->
+    uint @-> (* account *)
+    string @-> (* symbol *)
+    returning double
+  )
+
+let get_symbol_count =
+  foreign "get_symbol_count" (ptr execution_engine @-> returning int)
+
+let get_positions_batch =
+  foreign "get_positions_batch" (
+    ptr execution_engine @->
+    uint @-> (* account *)
+    ptr int @-> (* symbol_ids *)
+    int @-> (* count *)
+    ptr int @-> (* positions *)
+    ptr double @-> (* average_prices *)
+    ptr double @-> (* realized_pnls *)
+    ptr double @-> (* unrealized_pnls *)
+    returning int
+  )
+
+let get_all_positions =
+  foreign "get_all_positions" (
+    ptr execution_engine @->
+    uint @-> (* account *)
+    int @-> (* capacity *)
+    ptr int @-> (* symbol_ids *)
+    ptr int @-> (* positions *)
+    ptr double @-> (* average_prices *)
+    ptr double @-> (* realized_pnls *)
+    ptr double @-> (* unrealized_pnls *)
+    returning int
+  )
+
+let get_top_of_book_batch =
+  foreign "get_top_of_book_batch" (
+    ptr execution_engine @->
+    ptr int @-> (* symbol_ids *)
+    int @-> (* count *)
+    ptr double @-> (* best_bids *)
+    ptr double @-> (* best_asks *)
+    ptr int @-> (* bid_quantities *)
+    ptr int @-> (* ask_quantities *)
+    ptr double @-> (* last_prices *)
+    returning int
+  )
+
+let get_depth =
+  foreign "get_depth" (
+    ptr execution_engine @->
+    int @-> (* symbol_id *)
+    int @-> (* levels *)
+    ptr double @-> (* bid_prices *)
+    ptr int @-> (* bid_quantities *)
+    ptr int @-> (* bid_count *)
+    ptr double @-> (* ask_prices *)
+    ptr int @-> (* ask_quantities *)
+    ptr int @-> (* ask_count *)
+    returning uint64_t
+  )
+
+let open_l3_feed =
+  foreign "open_l3_feed" (
+    ptr execution_engine @->
+    int @-> (* symbol_id *)
+    returning (ptr l3_reader)
+  )
+
+let poll_l3_events =
+  foreign "poll_l3_events" (
+    ptr l3_reader @->
+    ptr l3_event_raw @-> (* events *)
+    int @-> (* capacity *)
+    returning int
+  )
+
+let get_l3_missed =
+  foreign "get_l3_missed" (ptr l3_reader @-> returning uint64_t)
+
+let close_l3_feed =
+  foreign "close_l3_feed" (ptr l3_reader @-> returning void)
+
 (* Callback types *)
 type market_data_callback = market_data -> unit
 type trade_callback = trade -> unit
+type depth_callback = depth_update -> unit
 
 let market_data_callback_typ = 
   Foreign.funptr (
@@ -114,6 +392,16 @@ let trade_callback_typ =
     returning void
   )
 
+let depth_callback_typ =
+  Foreign.funptr (
+    int @-> (* action *)
+    int @-> (* side *)
+    double @-> (* price *)
+    int @-> (* quantity *)
+    uint64_t @-> (* sequence *)
+    returning void
+  )
+
 let subscribe_market_data =
   foreign "subscribe_market_data" (
     ptr execution_engine @->
@@ -144,12 +432,28 @@ let unsubscribe_trades =
     returning void
   )
 
+let subscribe_depth =
+  foreign "subscribe_depth" (
+    ptr execution_engine @->
+    string @-> (* symbol *)
+    depth_callback_typ @->
+    returning void
+  )
+
+let unsubscribe_depth =
+  foreign "unsubscribe_depth" (
+    ptr execution_engine @->
+    string @-> (* symbol *)
+    returning void
+  )
+
 (* High-level wrapper *)
 module ExecutionEngine = struct
   type t = {
     engine: execution_engine ptr;
     mutable market_data_callbacks: (string, market_data_callback list) Hashtbl.t;
     mutable trade_callbacks: (string, trade_callback list) Hashtbl.t;
+    mutable depth_callbacks: (string, depth_callback list) Hashtbl.t;
   }
 
   let create () =
@@ -158,6 +462,7 @@ module ExecutionEngine = struct
       engine;
       market_data_callbacks = Hashtbl.create (module String);
       trade_callbacks = Hashtbl.create (module String);
+      depth_callbacks = Hashtbl.create (module String);
     }
 
   let destroy t =
@@ -179,9 +484,34 @@ module ExecutionEngine = struct
     in
     { order with order_id = Some order_id }
 
+  let register_symbol t symbol =
+    register_symbol t.engine symbol
+
+  let submit_order_by_id ?(order_type = Limit) t ~symbol_id ~price ~quantity ~side =
+    submit_order_by_id t.engine symbol_id price quantity side order_type
+
+  let submit_iceberg_order t ~symbol_id ~price ~quantity ~side ~display_quantity =
+    submit_iceberg_order t.engine symbol_id price quantity side display_quantity
+
+  (* Without ~limit_price the order is a plain stop that fires as a market order *)
+  let submit_stop_order ?limit_price t ~symbol_id ~stop_price ~quantity ~side =
+    match limit_price with
+    | Some limit_price ->
+        submit_stop_order t.engine symbol_id stop_price limit_price quantity side Stop_limit
+    | None -> submit_stop_order t.engine symbol_id stop_price 0.0 quantity side Stop
+
+  let submit_account_order ?(order_type = Limit) t ~account ~symbol_id ~price ~quantity ~side =
+    submit_account_order t.engine (Unsigned.UInt.of_int account) symbol_id price quantity side order_type
+
   let cancel_order t order_id =
     cancel_order t.engine order_id
 
+  let modify_order t order_id ~price ~quantity =
+    modify_order t.engine order_id price quantity
+
+  let cancel_all_orders t symbol =
+    cancel_all_orders t.engine symbol
+
   let get_position t symbol =
     get_position t.engine symbol
 
@@ -194,6 +524,74 @@ module ExecutionEngine = struct
   let get_realized_pnl t symbol =
     get_realized_pnl t.engine symbol
 
+  let get_best_bid t symbol =
+    get_best_bid t.engine symbol
+
+  let get_best_ask t symbol =
+    get_best_ask t.engine symbol
+
+  let get_account_position t ~account symbol =
+    get_account_position t.engine (Unsigned.UInt.of_int account) symbol
+
+  let get_account_average_price t ~account symbol =
+    get_account_average_price t.engine (Unsigned.UInt.of_int account) symbol
+
+  let get_account_unrealized_pnl t ~account symbol =
+    get_account_unrealized_pnl t.engine (Unsigned.UInt.of_int account) symbol
+
+  let get_account_realized_pnl t ~account symbol =
+    get_account_realized_pnl t.engine (Unsigned.UInt.of_int account) symbol
+
+  (* One FFI crossing for the whole portfolio *)
+  let read_position_columns ~symbol_id ~capacity fill =
+    let positions = CArray.make int capacity in
+    let average_prices = CArray.make double capacity in
+    let realized_pnls = CArray.make double capacity in
+    let unrealized_pnls = CArray.make double capacity in
+    let written =
+      fill (CArray.start positions) (CArray.start average_prices)
+        (CArray.start realized_pnls) (CArray.start unrealized_pnls)
+    in
+    let column arr = Array.init written ~f:(CArray.get arr) in
+    { symbol_ids = Array.init written ~f:symbol_id;
+      positions = column positions;
+      average_prices = column average_prices;
+      realized_pnls = column realized_pnls;
+      unrealized_pnls = column unrealized_pnls }
+
+  let get_positions_batch ?(account = 0) t symbol_ids =
+    let count = Array.length symbol_ids in
+    let ids = CArray.of_list int (Array.to_list symbol_ids) in
+    read_position_columns ~symbol_id:(Array.get symbol_ids) ~capacity:count
+      (get_positions_batch t.engine (Unsigned.UInt.of_int account) (CArray.start ids) count)
+
+  let get_all_positions ?(account = 0) t =
+    let capacity = get_symbol_count t.engine in
+    let ids = CArray.make int capacity in
+    read_position_columns ~symbol_id:(CArray.get ids) ~capacity
+      (get_all_positions t.engine (Unsigned.UInt.of_int account) capacity (CArray.start ids))
+
+  let get_top_of_book_batch t symbol_ids =
+    let count = Array.length symbol_ids in
+    let ids = CArray.of_list int (Array.to_list symbol_ids) in
+    let best_bids = CArray.make double count in
+    let best_asks = CArray.make double count in
+    let bid_quantities = CArray.make int count in
+    let ask_quantities = CArray.make int count in
+    let last_prices = CArray.make double count in
+    let written =
+      get_top_of_book_batch t.engine (CArray.start ids) count
+        (CArray.start best_bids) (CArray.start best_asks)
+        (CArray.start bid_quantities) (CArray.start ask_quantities)
+        (CArray.start last_prices)
+    in
+    let column arr = Array.init written ~f:(CArray.get arr) in
+    { best_bids = column best_bids;
+      best_asks = column best_asks;
+      bid_quantities = column bid_quantities;
+      ask_quantities = column ask_quantities;
+      last_prices = column last_prices }
+
   let subscribe_market_data t symbol callback =
     let callbacks = 
       match Hashtbl.find t.market_data_callbacks symbol with
@@ -223,4 +621,76 @@ module ExecutionEngine = struct
   let unsubscribe_trades t symbol =
     Hashtbl.remove t.trade_callbacks symbol;
     unsubscribe_trades t.engine symbol
+
+  let get_depth t ~symbol_id ~levels =
+    let bid_prices = CArray.make double levels in
+    let bid_quantities = CArray.make int levels in
+    let ask_prices = CArray.make double levels in
+    let ask_quantities = CArray.make int levels in
+    let bid_count = allocate int 0 in
+    let ask_count = allocate int 0 in
+    let sequence =
+      get_depth t.engine symbol_id levels
+        (CArray.start bid_prices) (CArray.start bid_quantities) bid_count
+        (CArray.start ask_prices) (CArray.start ask_quantities) ask_count
+    in
+    let side prices quantities count =
+      Array.init !@count ~f:(fun i -> (CArray.get prices i, CArray.get quantities i))
+    in
+    { bids = side bid_prices bid_quantities bid_count;
+      asks = side ask_prices ask_quantities ask_count;
+      sequence = Unsigned.UInt64.to_int64 sequence }
+
+  (* Each subscription is its own engine callback *)
+  let subscribe_depth t symbol callback =
+    let callbacks =
+      match Hashtbl.find t.depth_callbacks symbol with
+      | Some cbs -> callback :: cbs
+      | None -> [callback]
+    in
+    Hashtbl.set t.depth_callbacks ~key:symbol ~data:callbacks;
+    subscribe_depth t.engine symbol (fun action side price quantity sequence ->
+      let update = {
+        action = (match action with 0 -> Level_add | 1 -> Level_change | _ -> Level_delete);
+        side = (if side = 0 then Buy else Sell);
+        price;
+        quantity;
+        sequence = Unsigned.UInt64.to_int64 sequence;
+      } in
+      callback update
+    )
+
+  let unsubscribe_depth t symbol =
+    Hashtbl.remove t.depth_callbacks symbol;
+    unsubscribe_depth t.engine symbol
+
+  (* Readers are polled, not called back; close each one when done *)
+  let open_l3_feed t ~symbol_id =
+    open_l3_feed t.engine symbol_id
+
+  let poll_l3_events reader ~capacity =
+    let events = CArray.make l3_event_raw capacity in
+    let written = poll_l3_events reader (CArray.start events) capacity in
+    Array.init written ~f:(fun i ->
+      let event = CArray.get events i in
+      let id f = Unsigned.UInt64.to_string (getf event f) in
+      {
+        event_type = (match Unsigned.UInt8.to_int (getf event l3_type) with
+          | 0 -> L3_add | 1 -> L3_execute | 2 -> L3_cancel | _ -> L3_replace);
+        symbol_id = Unsigned.UInt32.to_int (getf event l3_symbol);
+        side = (if getf event l3_is_buy then Buy else Sell);
+        order_id = id l3_order_id;
+        other_order_id = id l3_other_order_id;
+        price = Int64.to_float (getf event l3_price) /. ticks_per_unit;
+        quantity = Int32.to_int_exn (getf event l3_quantity);
+        remaining_quantity = Int32.to_int_exn (getf event l3_remaining_quantity);
+        sequence = Unsigned.UInt64.to_int64 (getf event l3_sequence);
+        timestamp = getf event l3_timestamp;
+      })
+
+  let get_l3_missed reader =
+    Unsigned.UInt64.to_int64 (get_l3_missed reader)
+
+  let close_l3_feed reader =
+    close_l3_feed reader
 end
@@ -40,8 +40,18 @@ let rec eval_condition market_data condition =
   | Or (c1, c2) -> eval_condition market_data c1 || eval_condition market_data c2
   | Not c -> not (eval_condition market_data c)
 
+(* Hands a strategy order to the engine as a bindings order *)
+let submit_order engine (order : order) =
+  Bindings.ExecutionEngine.submit_order engine {
+    Bindings.symbol = order.symbol;
+    price = order.price;
+    quantity = order.quantity;
+    side = (match order.side with `Buy -> Bindings.Buy | `Sell -> Bindings.Sell);
+    order_id = None;
+  }
+
 (* Strategy execution *)
-let execute_strategy (engine: Bindings.Engine.t) (strategy: strategy) market_data_stream =
+let execute_strategy (engine: Bindings.ExecutionEngine.t) (strategy: strategy) market_data_stream =
   let execute_rule rule market_data =
     if eval_condition market_data rule.condition then
       match rule.action with
@@ -54,7 +64,7 @@ let execute_strategy (engine: Bindings.Engine.t) (strategy: strategy) market_dat
             timestamp = Time.now ();
           } in
           if Risk.validate_order strategy.risk_params order then
-            ignore (Bindings.Engine.submit engine order)
+            ignore (submit_order engine order)
       | Sell quantity ->
           let order = {
             symbol = rule.symbol;
@@ -64,10 +74,9 @@ let execute_strategy (engine: Bindings.Engine.t) (strategy: strategy) market_dat
             timestamp = Time.now ();
           } in
           if Risk.validate_order strategy.risk_params order then
-            ignore (Bindings.Engine.submit engine order)
+            ignore (submit_order engine order)
       | Cancel_all ->
-          (* TODO: Implement cancel all orders for symbol *)
-          ()
+          ignore (Bindings.ExecutionEngine.cancel_all_orders engine rule.symbol)
   in
   
   let process_market_data market_data =